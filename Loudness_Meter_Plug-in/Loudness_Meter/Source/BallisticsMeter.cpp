@@ -0,0 +1,192 @@
+/*
+  ==============================================================================
+
+    IEC 60268-10 PPM and IEC 60268-17 VU ballistics.
+
+  ==============================================================================
+*/
+
+#include "BallisticsMeter.h"
+
+namespace
+{
+	struct PPMSpec
+	{
+		double integrationSeconds;
+		double returnDb;
+		double returnSeconds;
+	};
+
+	//IEC 60268-10 Type I (DIN) and Type II (BBC / EBU)
+	const PPMSpec ppmSpecs[2] =
+	{
+		{ 0.005, 20.0, 1.5 },
+		{ 0.010, 24.0, 2.8 }
+	};
+
+	//an integration-time burst of 5 kHz tone reads 2 dB low
+	const double burstFrequency = 5000.0;
+	const double burstReading = std::pow(10.0, -2.0 / 20.0);
+
+	double readBurst(double attack, double sampleRate, double seconds)
+	{
+		double y = 0.0;
+		const int length = juce::jmax(1, juce::roundToInt(seconds * sampleRate));
+
+		for (int n = 0; n < length; ++n)
+		{
+			const double rectified = std::abs(std::sin(juce::MathConstants<double>::twoPi * burstFrequency * n / sampleRate));
+
+			if (rectified > y)
+				y += attack * (rectified - y);
+		}
+
+		return y;
+	}
+
+	//the rectifier only charges near the crests, so the attack is fitted to the
+	//burst rather than taken from 1 - exp(-T / tau) of a steady input
+	double fitAttack(double integrationSeconds, double sampleRate)
+	{
+		double lo = 0.0, hi = 1.0;
+
+		for (int i = 0; i < 40; ++i)
+		{
+			const double mid = 0.5 * (lo + hi);
+
+			if (readBurst(mid, sampleRate, integrationSeconds) < burstReading)
+				lo = mid;
+			else
+				hi = mid;
+		}
+
+		return 0.5 * (lo + hi);
+	}
+
+	//two equal first order sections reach 99% after 6.638 time constants
+	const double vuRiseSeconds = 0.3;
+	const double vuRiseToTimeConstant = 6.638;
+
+	//rectified average of a sine times this gives its RMS
+	const float vuSineCalibration = juce::MathConstants<float>::pi / (2.0f * juce::MathConstants<float>::sqrt2);
+}
+
+BallisticsMeter::BallisticsMeter()
+{
+	prepare(48000.0, 2);
+}
+
+void BallisticsMeter::prepare(double sampleRate, int newNumChannels)
+{
+	jassert(newNumChannels <= maxChannels);
+
+	numChannels = juce::jlimit(0, maxChannels, newNumChannels);
+	numLanes = juce::jmin(maxChannels, (numChannels + 3) & ~3);
+
+	for (int type = 0; type < 2; ++type)
+	{
+		const auto& spec = ppmSpecs[type];
+
+		ppmAttack[type] = (float)fitAttack(spec.integrationSeconds, sampleRate);
+		ppmRelease[type] = (float)std::pow(10.0, -spec.returnDb / (20.0 * spec.returnSeconds * sampleRate));
+	}
+
+	vuCoefficient = (float)(1.0 - std::exp(-vuRiseToTimeConstant / (vuRiseSeconds * sampleRate)));
+
+	reset();
+}
+
+void BallisticsMeter::reset()
+{
+	std::fill(std::begin(ppmI), std::end(ppmI), 0.0f);
+	std::fill(std::begin(ppmII), std::end(ppmII), 0.0f);
+	std::fill(std::begin(vuStage1), std::end(vuStage1), 0.0f);
+	std::fill(std::begin(vuStage2), std::end(vuStage2), 0.0f);
+	std::fill(std::begin(interleaved), std::end(interleaved), 0.0f);
+
+	for (int scale = 0; scale < numScales; ++scale)
+		for (int ch = 0; ch < maxChannels; ++ch)
+			levels[scale][ch].store(0.0f);
+}
+
+float BallisticsMeter::getLevel(Scale scale, int channel) const
+{
+	if (!juce::isPositiveAndBelow(channel, maxChannels) || !juce::isPositiveAndBelow((int)scale, (int)numScales))
+		return 0.0f;
+
+	return levels[scale][channel].load(std::memory_order_relaxed);
+}
+
+juce::String BallisticsMeter::getScaleName(Scale scale)
+{
+	switch (scale)
+	{
+	case ppmTypeI:
+		return "PPM I";
+	case ppmTypeII:
+		return "PPM II";
+	case vu:
+		return "VU";
+	default:
+		jassertfalse;
+		return {};
+	}
+}
+
+void BallisticsMeter::process(const juce::AudioBuffer<float>& buffer)
+{
+	jassert(buffer.getNumChannels() >= numChannels);
+
+	for (auto& scaleMax : blockMax)
+		std::fill(std::begin(scaleMax), std::end(scaleMax), 0.0f);
+
+	auto* const* channels = buffer.getArrayOfReadPointers();
+	const int numSamples = buffer.getNumSamples();
+
+	for (int start = 0; start < numSamples; start += maxChunkSize)
+		processChunk(channels, start, juce::jmin(maxChunkSize, numSamples - start));
+
+	//decimated to one reading per block for the display
+	for (int ch = 0; ch < numChannels; ++ch)
+	{
+		levels[ppmTypeI][ch].store(blockMax[ppmTypeI][ch], std::memory_order_relaxed);
+		levels[ppmTypeII][ch].store(blockMax[ppmTypeII][ch], std::memory_order_relaxed);
+		levels[vu][ch].store(blockMax[vu][ch] * vuSineCalibration, std::memory_order_relaxed);
+	}
+}
+
+void BallisticsMeter::processChunk(const float* const* channels, int startSample, int numSamples)
+{
+	for (int ch = 0; ch < numChannels; ++ch)
+	{
+		auto* src = channels[ch] + startSample;
+
+		for (int i = 0; i < numSamples; ++i)
+			interleaved[i * numLanes + ch] = src[i];
+	}
+
+	const float attackI = ppmAttack[0], releaseI = ppmRelease[0];
+	const float attackII = ppmAttack[1], releaseII = ppmRelease[1];
+	const float vuCoeff = vuCoefficient;
+
+	for (int i = 0; i < numSamples; ++i)
+	{
+		auto* x = interleaved + i * numLanes;
+
+		//branch free, so the lane loop compiles to compares and blends
+		for (int ch = 0; ch < numLanes; ++ch)
+		{
+			const float rectified = std::abs(x[ch]);
+
+			ppmI[ch] = rectified > ppmI[ch] ? ppmI[ch] + attackI * (rectified - ppmI[ch]) : ppmI[ch] * releaseI;
+			ppmII[ch] = rectified > ppmII[ch] ? ppmII[ch] + attackII * (rectified - ppmII[ch]) : ppmII[ch] * releaseII;
+
+			vuStage1[ch] += vuCoeff * (rectified - vuStage1[ch]);
+			vuStage2[ch] += vuCoeff * (vuStage1[ch] - vuStage2[ch]);
+
+			blockMax[ppmTypeI][ch] = juce::jmax(blockMax[ppmTypeI][ch], ppmI[ch]);
+			blockMax[ppmTypeII][ch] = juce::jmax(blockMax[ppmTypeII][ch], ppmII[ch]);
+			blockMax[vu][ch] = juce::jmax(blockMax[vu][ch], vuStage2[ch]);
+		}
+	}
+}
@@ -0,0 +1,266 @@
+/*
+  ==============================================================================
+
+    FFT frame generators shared by the plug-in editor and the offline tools.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "PluginProcessor.h"
+#include "SpectrumKernels.h"
+
+enum FFTOrder
+{
+	order2048 = 11,
+	order4096 = 12,
+	order8192 = 13
+};
+
+//window policies
+struct BlackmanHarrisWindow
+{
+	static constexpr auto method = juce::dsp::WindowingFunction<float>::blackmanHarris;
+};
+
+struct HannWindow
+{
+	static constexpr auto method = juce::dsp::WindowingFunction<float>::hann;
+};
+
+/**
+ Window table and FFT plan for one (window, order), built the first time it is
+ asked for and then shared by every generator of that configuration in the process.
+ Both are read only after construction, so sharing them across threads is safe.
+ */
+template<typename WindowPolicy, int Order>
+struct FFTSetup
+{
+	static constexpr int fftSize = 1 << Order;
+
+	static const FFTSetup& get()
+	{
+		static const FFTSetup setup;
+		return setup;
+	}
+
+	juce::dsp::FFT fft{ Order };
+	std::array<float, fftSize> window;
+private:
+	FFTSetup()
+	{
+		juce::dsp::WindowingFunction<float>::fillWindowingTables(window.data(), fftSize, WindowPolicy::method, true);
+	}
+};
+
+/**
+ Windowed, normalised dB magnitudes of one frame, for a fixed window and order.
+ The sizes are compile time constants, so the per-bin loops have known trip counts.
+ */
+template<typename BlockType, typename WindowPolicy, int Order>
+struct FFTDataGenerator
+{
+	static constexpr int fftSize = 1 << Order;
+	static constexpr int numBins = fftSize / 2;
+
+	FFTDataGenerator() : setup(FFTSetup<WindowPolicy, Order>::get())
+	{
+		fftData.resize(fftSize * 2, 0);
+		fftDataFifo.prepare(fftData.size());
+	}
+
+	/**
+	 produces the FFT data from an audio buffer.
+	 */
+	void produceFFTDataForRendering(const juce::AudioBuffer<float>& audioData, const float negativeInfinity)
+	{
+		produceFFTDataForRendering(audioData.getReadPointer(0), negativeInfinity);
+	}
+
+	/** Same, from the fftSize samples starting at 'frame'. */
+	void produceFFTDataForRendering(const float* frame, const float negativeInfinity)
+	{
+		// first apply a windowing function to our data, the upper half is FFT scratch space
+		juce::FloatVectorOperations::multiply(fftData.data(), frame, setup.window.data(), fftSize);
+
+		// then render our FFT data..
+		setup.fft.performFrequencyOnlyForwardTransform(fftData.data());
+
+		//normalise, drop NaN / Inf and convert to dB in one vectorised pass
+		SpectrumKernels::magnitudesToDecibels(fftData.data(), numBins, 1.0f / float(numBins), negativeInfinity);
+
+		fftDataFifo.push(fftData);
+	}
+	//==============================================================================
+	int getNumAvailableFFTDataBlocks() const { return fftDataFifo.getNumAvailableForReading(); }
+	//==============================================================================
+	bool getFFTData(BlockType& data) { return fftDataFifo.pull(data); }
+private:
+	const FFTSetup<WindowPolicy, Order>& setup;
+	BlockType fftData;
+
+	Fifo<BlockType> fftDataFifo;
+};
+
+/**
+ Two real channels through one complex FFT: left goes in the real part, right in
+ the imaginary part, and the spectra are separated afterwards with
+ L[k] = (Z[k] + conj(Z[N - k])) / 2 and R[k] = (Z[k] - conj(Z[N - k])) / 2i.
+ Same window, framing and output as two FFTDataGenerators at about half the FFT cost.
+ */
+template<typename BlockType, typename WindowPolicy, int Order>
+struct StereoFFTDataGenerator
+{
+	static constexpr int fftSize = 1 << Order;
+	static constexpr int numBins = fftSize / 2;
+
+	using Complex = juce::dsp::Complex<float>;
+
+	StereoFFTDataGenerator() : setup(FFTSetup<WindowPolicy, Order>::get())
+	{
+		packed.resize(fftSize);
+		spectrum.resize(fftSize);
+
+		for (int ch = 0; ch < 2; ++ch)
+		{
+			//only the bins are kept, no FFT scratch space is needed here
+			fftData[ch].resize(numBins, 0);
+			fftDataFifo[ch].prepare(fftData[ch].size());
+		}
+	}
+
+	/** From the fftSize samples starting at 'left' and 'right'. */
+	void produceFFTDataForRendering(const float* left, const float* right, const float negativeInfinity)
+	{
+		const auto* window = setup.window.data();
+
+		for (int i = 0; i < fftSize; ++i)
+			packed[i] = Complex(left[i] * window[i], right[i] * window[i]);
+
+		setup.fft.perform(packed.data(), spectrum.data(), false);
+
+		//only the magnitudes are drawn, so |a + b| / 2 and |a - b| / 2 are enough
+		auto* leftData = fftData[0].data();
+		auto* rightData = fftData[1].data();
+
+		for (int k = 0; k < numBins; ++k)
+		{
+			const auto a = spectrum[k];
+			const auto b = std::conj(spectrum[(fftSize - k) & (fftSize - 1)]);
+
+			leftData[k] = 0.5f * std::abs(a + b);
+			rightData[k] = 0.5f * std::abs(a - b);
+		}
+
+		for (int ch = 0; ch < 2; ++ch)
+		{
+			SpectrumKernels::magnitudesToDecibels(fftData[ch].data(), numBins, 1.0f / float(numBins), negativeInfinity);
+			fftDataFifo[ch].push(fftData[ch]);
+		}
+	}
+	//==============================================================================
+	int getNumAvailableFFTDataBlocks() const { return fftDataFifo[1].getNumAvailableForReading(); }
+	//==============================================================================
+	/** Pull both channels together, they are always pushed as a pair. */
+	bool getFFTData(BlockType& left, BlockType& right) { return fftDataFifo[0].pull(left) && fftDataFifo[1].pull(right); }
+private:
+	const FFTSetup<WindowPolicy, Order>& setup;
+	std::vector<Complex> packed, spectrum;
+	BlockType fftData[2];
+
+	Fifo<BlockType> fftDataFifo[2];
+};
+
+/**
+ Runtime choice between the FFTOrder specialisations of one window.
+ A generator is built the first time its order is selected and kept afterwards,
+ so switching back to an order does not allocate again. After prepareAllOrders()
+ changeOrder() never allocates.
+ */
+template<typename BlockType, typename WindowPolicy, template<typename, typename, int> class Generator = FFTDataGenerator>
+struct FFTDataGeneratorSet
+{
+	static constexpr int maxFFTSize = 1 << FFTOrder::order8192;
+
+	FFTDataGeneratorSet() { changeOrder(FFTOrder::order2048); }
+
+	//forwards to the active Generator's overloads
+	template<typename... Args>
+	void produceFFTDataForRendering(const Args&... args)
+	{
+		visitActive([&](auto& generator) { generator.produceFFTDataForRendering(args...); });
+	}
+
+	/** Builds every order up front, the active one stays selected. */
+	void prepareAllOrders()
+	{
+		const auto activeOrder = order;
+
+		for (auto o : { FFTOrder::order2048, FFTOrder::order4096, FFTOrder::order8192 })
+			changeOrder(o);
+
+		changeOrder(activeOrder);
+	}
+
+	void changeOrder(FFTOrder newOrder)
+	{
+		order = newOrder;
+
+		switch (order)
+		{
+		case FFTOrder::order2048:
+			if (generator2048 == nullptr)
+				generator2048 = std::make_unique<Generator<BlockType, WindowPolicy, FFTOrder::order2048>>();
+			break;
+		case FFTOrder::order4096:
+			if (generator4096 == nullptr)
+				generator4096 = std::make_unique<Generator<BlockType, WindowPolicy, FFTOrder::order4096>>();
+			break;
+		case FFTOrder::order8192:
+			if (generator8192 == nullptr)
+				generator8192 = std::make_unique<Generator<BlockType, WindowPolicy, FFTOrder::order8192>>();
+			break;
+		default:
+			jassertfalse;
+			break;
+		}
+	}
+	//==============================================================================
+	FFTOrder getOrder() const { return order; }
+	int getFFTSize() const { return 1 << order; }
+	int getNumAvailableFFTDataBlocks() { return visitActive([](auto& generator) { return generator.getNumAvailableFFTDataBlocks(); }); }
+	//==============================================================================
+	template<typename... Args>
+	bool getFFTData(Args&... args) { return visitActive([&](auto& generator) { return generator.getFFTData(args...); }); }
+private:
+	template<typename Function>
+	decltype(auto) visitActive(Function&& fn)
+	{
+		switch (order)
+		{
+		case FFTOrder::order4096:
+			return fn(*generator4096);
+		case FFTOrder::order8192:
+			return fn(*generator8192);
+		default:
+			return fn(*generator2048);
+		}
+	}
+
+	FFTOrder order = FFTOrder::order2048;
+
+	std::unique_ptr<Generator<BlockType, WindowPolicy, FFTOrder::order2048>> generator2048;
+	std::unique_ptr<Generator<BlockType, WindowPolicy, FFTOrder::order4096>> generator4096;
+	std::unique_ptr<Generator<BlockType, WindowPolicy, FFTOrder::order8192>> generator8192;
+};
+
+template<typename BlockType>
+using FFTDataGeneratorRMS = FFTDataGeneratorSet<BlockType, BlackmanHarrisWindow>;
+
+template<typename BlockType>
+using FFTDataGeneratorSpectr = FFTDataGeneratorSet<BlockType, HannWindow>;
+
+template<typename BlockType>
+using StereoFFTDataGeneratorRMS = FFTDataGeneratorSet<BlockType, BlackmanHarrisWindow, StereoFFTDataGenerator>;
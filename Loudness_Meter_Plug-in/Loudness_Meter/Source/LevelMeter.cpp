@@ -0,0 +1,190 @@
+/*
+  ==============================================================================
+
+    Time-domain RMS and sample-peak levels.
+
+  ==============================================================================
+*/
+
+#include "LevelMeter.h"
+
+LevelMeter::LevelMeter()
+{
+	for (int ch = 0; ch < maxChannels; ++ch)
+	{
+		rms[ch].store(0.0f);
+		peak[ch].store(0.0f);
+	}
+}
+
+void LevelMeter::prepare(double sampleRate, int newNumChannels)
+{
+	jassert(newNumChannels <= maxChannels);
+
+	numChannels = juce::jlimit(0, maxChannels, newNumChannels);
+	samplesPerSlot = juce::jmax(1, juce::roundToInt(sampleRate * slotSeconds));
+	samplesInSlot = 0;
+	slotIndex = 0;
+	slotCount = 0;
+
+	channels.assign((size_t)numChannels, ChannelState());
+
+	for (auto& state : channels)
+	{
+		state.slotSums.fill(0.0);
+		state.slotPeaks.fill(0.0f);
+	}
+
+	for (int ch = 0; ch < maxChannels; ++ch)
+	{
+		rms[ch].store(0.0f);
+		peak[ch].store(0.0f);
+	}
+
+	currentWindow = -1;
+}
+
+float LevelMeter::getRMS(int channel) const
+{
+	return juce::isPositiveAndBelow(channel, maxChannels) ? rms[channel].load(std::memory_order_relaxed) : 0.0f;
+}
+
+float LevelMeter::getPeak(int channel) const
+{
+	return juce::isPositiveAndBelow(channel, maxChannels) ? peak[channel].load(std::memory_order_relaxed) : 0.0f;
+}
+
+double LevelMeter::sumOfSquares(const float* samples, int numSamples)
+{
+	//four independent accumulators, so the loop vectorises without reassociation
+	float acc[4] = {};
+
+	int i = 0;
+	for (; i + 4 <= numSamples; i += 4)
+		for (int lane = 0; lane < 4; ++lane)
+			acc[lane] += samples[i + lane] * samples[i + lane];
+
+	double sum = (double)acc[0] + acc[1] + acc[2] + acc[3];
+
+	for (; i < numSamples; ++i)
+		sum += samples[i] * samples[i];
+
+	return sum;
+}
+
+void LevelMeter::process(const juce::AudioBuffer<float>& buffer)
+{
+	jassert(buffer.getNumChannels() >= numChannels);
+
+	auto window = requestedWindow.load();
+	if (window != currentWindow)
+	{
+		applyWindow(window == window3s ? maxSlots : maxSlots / 10);
+		currentWindow = window;
+	}
+
+	const int numSamples = buffer.getNumSamples();
+
+	int start = 0;
+	while (start < numSamples)
+	{
+		const int numThisTime = juce::jmin(numSamples - start, samplesPerSlot - samplesInSlot);
+
+		for (int ch = 0; ch < numChannels; ++ch)
+		{
+			auto* samples = buffer.getReadPointer(ch, start);
+			auto& state = channels[(size_t)ch];
+
+			auto range = juce::FloatVectorOperations::findMinAndMax(samples, numThisTime);
+
+			state.currentSum += sumOfSquares(samples, numThisTime);
+			state.currentPeak = juce::jmax(state.currentPeak, -range.getStart(), range.getEnd());
+		}
+
+		start += numThisTime;
+		samplesInSlot += numThisTime;
+
+		if (samplesInSlot == samplesPerSlot)
+			finishSlot();
+	}
+}
+
+void LevelMeter::finishSlot()
+{
+	const int oldestIndex = (slotIndex - numWindowSlots + maxSlots) % maxSlots;
+	const bool windowFull = slotCount >= numWindowSlots;
+	//the running sums are rebuilt once per lap of the ring so rounding never piles up
+	const bool rebuildSums = slotIndex == maxSlots - 1;
+
+	for (int ch = 0; ch < numChannels; ++ch)
+	{
+		auto& state = channels[(size_t)ch];
+
+		if (windowFull)
+			state.windowSum -= state.slotSums[(size_t)oldestIndex];
+
+		state.slotSums[(size_t)slotIndex] = state.currentSum;
+		state.slotPeaks[(size_t)slotIndex] = state.currentPeak;
+		state.windowSum += state.currentSum;
+
+		if (rebuildSums)
+		{
+			state.windowSum = 0.0;
+			for (int i = 0; i < juce::jmin<juce::int64>(numWindowSlots, slotCount + 1); ++i)
+				state.windowSum += state.slotSums[(size_t)((slotIndex - i + maxSlots) % maxSlots)];
+		}
+
+		//drop the slots that left the window, then the ones the new slot beats
+		if (state.queueSize > 0 && windowFull && state.peakQueue[(size_t)state.queueStart] == oldestIndex)
+		{
+			state.queueStart = (state.queueStart + 1) % maxSlots;
+			--state.queueSize;
+		}
+
+		while (state.queueSize > 0
+			&& state.slotPeaks[(size_t)state.peakQueue[(size_t)((state.queueStart + state.queueSize - 1) % maxSlots)]] <= state.currentPeak)
+			--state.queueSize;
+
+		state.peakQueue[(size_t)((state.queueStart + state.queueSize) % maxSlots)] = slotIndex;
+		++state.queueSize;
+
+		const auto numWindowSamples = (double)samplesPerSlot * (double)juce::jmin<juce::int64>(numWindowSlots, slotCount + 1);
+
+		rms[ch].store((float)std::sqrt(juce::jmax(0.0, state.windowSum) / numWindowSamples), std::memory_order_relaxed);
+		peak[ch].store(state.slotPeaks[(size_t)state.peakQueue[(size_t)state.queueStart]], std::memory_order_relaxed);
+
+		state.currentSum = 0.0;
+		state.currentPeak = 0.0f;
+	}
+
+	slotIndex = (slotIndex + 1) % maxSlots;
+	++slotCount;
+	samplesInSlot = 0;
+}
+
+void LevelMeter::applyWindow(int newNumWindowSlots)
+{
+	numWindowSlots = newNumWindowSlots;
+
+	//re-derive the running sum and the peak queue from the slots already in the ring,
+	//so switching windows does not restart the measurement
+	const int numValid = (int)juce::jmin<juce::int64>(numWindowSlots, slotCount);
+
+	for (auto& state : channels)
+	{
+		state.windowSum = 0.0;
+		state.queueStart = 0;
+		state.queueSize = 0;
+
+		for (int age = numValid; age >= 1; --age)
+		{
+			const int index = (slotIndex - age + maxSlots) % maxSlots;
+			state.windowSum += state.slotSums[(size_t)index];
+
+			while (state.queueSize > 0 && state.slotPeaks[(size_t)state.peakQueue[(size_t)(state.queueSize - 1)]] <= state.slotPeaks[(size_t)index])
+				--state.queueSize;
+
+			state.peakQueue[(size_t)state.queueSize++] = index;
+		}
+	}
+}
@@ -0,0 +1,85 @@
+/*
+  ==============================================================================
+
+    Time-domain RMS and sample-peak levels.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+/**
+ Per channel RMS and sample peak over a sliding 300 ms or 3 s window.
+ Every block is reduced to a sum of squares and a peak per 10 ms slot. The window
+ is a running sum over those slots plus a monotonic queue for the peak, so the
+ cost per sample is constant whatever the window length.
+ Levels are linear and published through atomics.
+ */
+class LevelMeter
+{
+public:
+	static constexpr int maxChannels = 12;
+
+	enum IntegrationWindow
+	{
+		window300ms,
+		window3s
+	};
+
+	LevelMeter();
+
+	/** Allocates the slot history, not real time safe. */
+	void prepare(double sampleRate, int numChannels);
+
+	/** Any thread, applied at the start of the next process() call. */
+	void setIntegrationWindow(IntegrationWindow window) { requestedWindow.store(window); }
+
+	/** Audio thread, uses the first numChannels channels of buffer. */
+	void process(const juce::AudioBuffer<float>& buffer);
+	//==============================================================================
+	int getNumChannels() const { return numChannels; }
+	float getRMS(int channel) const;
+	float getPeak(int channel) const;
+private:
+	static constexpr double slotSeconds = 0.01;
+	static constexpr int maxSlots = 300;
+
+	struct ChannelState
+	{
+		std::array<double, maxSlots> slotSums;
+		std::array<float, maxSlots> slotPeaks;
+
+		//indices of slots whose peak is not beaten by a newer slot, oldest first
+		std::array<int, maxSlots> peakQueue;
+		int queueStart = 0;
+		int queueSize = 0;
+
+		double windowSum = 0.0;
+		double currentSum = 0.0;
+		float currentPeak = 0.0f;
+	};
+
+	void applyWindow(int newNumWindowSlots);
+	void finishSlot();
+
+	static double sumOfSquares(const float* samples, int numSamples);
+
+	int numChannels = 0;
+	int samplesPerSlot = 480;
+	int samplesInSlot = 0;
+	int numWindowSlots = 30;
+	int slotIndex = 0;       //slot being filled
+	juce::int64 slotCount = 0;
+
+	std::vector<ChannelState> channels;
+
+	std::atomic<int> requestedWindow{ window300ms };
+	int currentWindow = -1;
+
+	std::atomic<float> rms[maxChannels];
+	std::atomic<float> peak[maxChannels];
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(LevelMeter)
+};
@@ -0,0 +1,352 @@
+/*
+  ==============================================================================
+
+    ITU-R BS.1770-4 / EBU R128 loudness measurement.
+
+  ==============================================================================
+*/
+
+#include "LoudnessMeter.h"
+
+LoudnessMeter::LoudnessMeter()
+{
+	std::fill(std::begin(weights), std::end(weights), 1.0);
+	prepare(48000.0, 2);
+}
+
+void LoudnessMeter::prepare(double sampleRate, int newNumChannels)
+{
+	jassert(newNumChannels <= maxChannels);
+
+	numChannels = juce::jlimit(0, maxChannels, newNumChannels);
+	//whole groups of four, so the lane loops have a vector friendly trip count
+	numLanes = juce::jmin(maxChannels, (numChannels + 3) & ~3);
+	samplesPerStep = juce::jmax(1, juce::roundToInt(sampleRate * 0.1));
+
+	//BS.1770-4 pre-filter (high shelf), re-derived for sampleRate
+	{
+		const double f0 = 1681.974450955533;
+		const double gainDb = 3.999843853973347;
+		const double q = 0.7071752369554196;
+
+		const double k = std::tan(juce::MathConstants<double>::pi * f0 / sampleRate);
+		const double vh = std::pow(10.0, gainDb / 20.0);
+		const double vb = std::pow(vh, 0.4996667741545416);
+		const double a0 = 1.0 + k / q + k * k;
+
+		preFilter.b0 = (vh + vb * k / q + k * k) / a0;
+		preFilter.b1 = 2.0 * (k * k - vh) / a0;
+		preFilter.b2 = (vh - vb * k / q + k * k) / a0;
+		preFilter.a1 = 2.0 * (k * k - 1.0) / a0;
+		preFilter.a2 = (1.0 - k / q + k * k) / a0;
+	}
+
+	//revised low-frequency B-curve (high pass)
+	{
+		const double f0 = 38.13547087602444;
+		const double q = 0.5003270373238773;
+
+		const double k = std::tan(juce::MathConstants<double>::pi * f0 / sampleRate);
+		const double a0 = 1.0 + k / q + k * k;
+
+		rlbFilter.b0 = 1.0;
+		rlbFilter.b1 = -2.0;
+		rlbFilter.b2 = 1.0;
+		rlbFilter.a1 = 2.0 * (k * k - 1.0) / a0;
+		rlbFilter.a2 = (1.0 - k / q + k * k) / a0;
+	}
+
+	reset();
+}
+
+void LoudnessMeter::reset()
+{
+	std::fill(std::begin(preState1), std::end(preState1), 0.0);
+	std::fill(std::begin(preState2), std::end(preState2), 0.0);
+	std::fill(std::begin(rlbState1), std::end(rlbState1), 0.0);
+	std::fill(std::begin(rlbState2), std::end(rlbState2), 0.0);
+	std::fill(std::begin(stepSum), std::end(stepSum), 0.0);
+	std::fill(std::begin(interleaved), std::end(interleaved), 0.0);
+
+	stepPowers.fill(0.0);
+	stepIndex = 0;
+	stepsSinceReset = 0;
+	samplesInStep = 0;
+
+	momentaryLoudness.store(minLoudness);
+	shortTermLoudness.store(minLoudness);
+}
+
+void LoudnessMeter::setChannelWeight(int channel, float weight)
+{
+	if (juce::isPositiveAndBelow(channel, maxChannels))
+		weights[channel] = weight;
+}
+
+float LoudnessMeter::getChannelWeight(juce::AudioChannelSet::ChannelType type)
+{
+	using Set = juce::AudioChannelSet;
+
+	switch (type)
+	{
+	case Set::LFE:
+	case Set::LFE2:
+		return 0.0f;
+	case Set::leftSurround:
+	case Set::rightSurround:
+	case Set::leftSurroundSide:
+	case Set::rightSurroundSide:
+	case Set::wideLeft:
+	case Set::wideRight:
+		return 1.41f;
+	default:
+		//front, rear and height channels
+		return 1.0f;
+	}
+}
+
+float LoudnessMeter::powerToLoudness(double power)
+{
+	if (power <= 0.0)
+		return minLoudness;
+
+	return juce::jmax(minLoudness, (float)(-0.691 + 10.0 * std::log10(power)));
+}
+
+void LoudnessMeter::process(const juce::AudioBuffer<float>& buffer)
+{
+	jassert(buffer.getNumChannels() >= numChannels);
+
+	auto* const* channels = buffer.getArrayOfReadPointers();
+	const int numSamples = buffer.getNumSamples();
+
+	int start = 0;
+	while (start < numSamples)
+	{
+		//never let a chunk run across a 100 ms step
+		const int numThisTime = juce::jmin(numSamples - start, maxChunkSize, samplesPerStep - samplesInStep);
+
+		processChunk(channels, start, numThisTime);
+
+		start += numThisTime;
+		samplesInStep += numThisTime;
+
+		if (samplesInStep == samplesPerStep)
+			finishStep();
+	}
+}
+
+void LoudnessMeter::processChunk(const float* const* channels, int startSample, int numSamples)
+{
+	//transpose into sample-major order, padding lanes stay at zero
+	for (int ch = 0; ch < numChannels; ++ch)
+	{
+		auto* src = channels[ch] + startSample;
+
+		for (int i = 0; i < numSamples; ++i)
+			interleaved[i * numLanes + ch] = src[i];
+	}
+
+	const auto pre = preFilter;
+	const auto rlb = rlbFilter;
+
+	for (int i = 0; i < numSamples; ++i)
+	{
+		auto* x = interleaved + i * numLanes;
+
+		//transposed direct form II, one lane per channel
+		for (int ch = 0; ch < numLanes; ++ch)
+		{
+			const double in = x[ch];
+
+			const double y1 = pre.b0 * in + preState1[ch];
+			preState1[ch] = pre.b1 * in - pre.a1 * y1 + preState2[ch];
+			preState2[ch] = pre.b2 * in - pre.a2 * y1;
+
+			const double y2 = rlb.b0 * y1 + rlbState1[ch];
+			rlbState1[ch] = rlb.b1 * y1 - rlb.a1 * y2 + rlbState2[ch];
+			rlbState2[ch] = rlb.b2 * y1 - rlb.a2 * y2;
+
+			stepSum[ch] += y2 * y2;
+		}
+	}
+}
+
+void LoudnessMeter::finishStep()
+{
+	double power = 0.0;
+
+	for (int ch = 0; ch < numChannels; ++ch)
+		power += weights[ch] * stepSum[ch];
+
+	std::fill(std::begin(stepSum), std::end(stepSum), 0.0);
+
+	stepPowers[(size_t)stepIndex] = power / (double)samplesPerStep;
+	stepIndex = (stepIndex + 1) % stepsPerShortTerm;
+	samplesInStep = 0;
+
+	double momentary = 0.0, shortTerm = 0.0;
+
+	for (int i = 0; i < stepsPerShortTerm; ++i)
+	{
+		//i == 0 is the newest step
+		auto stepPower = stepPowers[(size_t)((stepIndex - 1 - i + stepsPerShortTerm) % stepsPerShortTerm)];
+
+		if (i < stepsPerMomentary)
+			momentary += stepPower;
+
+		shortTerm += stepPower;
+	}
+
+	momentaryLoudness.store(powerToLoudness(momentary / stepsPerMomentary), std::memory_order_relaxed);
+	shortTermLoudness.store(powerToLoudness(shortTerm / stepsPerShortTerm), std::memory_order_relaxed);
+
+	stepsSinceReset = juce::jmin(stepsSinceReset + 1, stepsPerShortTerm);
+
+	if (listener != nullptr)
+	{
+		Step step;
+		step.momentaryPower = momentary / stepsPerMomentary;
+		step.shortTermPower = shortTerm / stepsPerShortTerm;
+		step.momentaryComplete = stepsSinceReset >= stepsPerMomentary;
+		step.shortTermComplete = stepsSinceReset >= stepsPerShortTerm;
+
+		listener->loudnessStepFinished(step);
+	}
+}
+
+//==============================================================================
+LoudnessHistogram::LoudnessHistogram() : counts(new std::atomic<uint32_t>[numBins])
+{
+	clear();
+}
+
+void LoudnessHistogram::clear()
+{
+	for (int i = 0; i < numBins; ++i)
+		counts[i].store(0, std::memory_order_relaxed);
+}
+
+void LoudnessHistogram::add(double power)
+{
+	auto loudness = LoudnessMeter::powerToLoudness(power);
+
+	if (loudness < absoluteGate)
+		return;
+
+	//single writer, so a plain load and store is enough
+	auto& count = counts[getBinIndex(loudness)];
+	count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+double LoudnessHistogram::getMeanPower(float gateLoudness) const
+{
+	const auto& binPowers = getBinPowers();
+
+	double sum = 0.0;
+	uint64_t total = 0;
+
+	for (int i = getBinIndex(gateLoudness); i < numBins; ++i)
+	{
+		auto count = counts[i].load(std::memory_order_relaxed);
+		sum += count * binPowers[(size_t)i];
+		total += count;
+	}
+
+	return total > 0 ? sum / (double)total : 0.0;
+}
+
+float LoudnessHistogram::getPercentile(float gateLoudness, double fraction) const
+{
+	const auto firstBin = getBinIndex(gateLoudness);
+
+	uint64_t total = 0;
+	for (int i = firstBin; i < numBins; ++i)
+		total += counts[i].load(std::memory_order_relaxed);
+
+	if (total == 0)
+		return gateLoudness;
+
+	auto rank = (uint64_t)std::ceil(fraction * (double)total);
+	uint64_t cumulative = 0;
+
+	for (int i = firstBin; i < numBins; ++i)
+	{
+		cumulative += counts[i].load(std::memory_order_relaxed);
+
+		if (cumulative >= juce::jmax<uint64_t>(1, rank))
+			return getBinLoudness(i);
+	}
+
+	return maxLoudness;
+}
+
+int LoudnessHistogram::getBinIndex(float loudness)
+{
+	return juce::jlimit(0, numBins - 1, (int)std::floor((loudness - absoluteGate) * binsPerLU));
+}
+
+float LoudnessHistogram::getBinLoudness(int binIndex)
+{
+	return absoluteGate + (binIndex + 0.5f) / (float)binsPerLU;
+}
+
+const std::array<double, LoudnessHistogram::numBins>& LoudnessHistogram::getBinPowers()
+{
+	//power at the centre of every bin, shared by all instances
+	static const auto binPowers = []
+	{
+		std::array<double, numBins> powers;
+
+		for (int i = 0; i < numBins; ++i)
+			powers[(size_t)i] = std::pow(10.0, (getBinLoudness(i) + 0.691) / 10.0);
+
+		return powers;
+	}();
+
+	return binPowers;
+}
+
+//==============================================================================
+void LoudnessIntegrator::reset()
+{
+	momentaryBlocks.clear();
+	shortTermValues.clear();
+}
+
+void LoudnessIntegrator::loudnessStepFinished(const LoudnessMeter::Step& step)
+{
+	if (isPaused())
+		return;
+
+	//400 ms gating blocks with 75% overlap, and 3 s short-term values at 10 Hz
+	if (step.momentaryComplete)
+		momentaryBlocks.add(step.momentaryPower);
+
+	if (step.shortTermComplete)
+		shortTermValues.add(step.shortTermPower);
+}
+
+float LoudnessIntegrator::getIntegratedLoudness() const
+{
+	auto absoluteGated = momentaryBlocks.getMeanPower(LoudnessHistogram::absoluteGate);
+
+	if (absoluteGated <= 0.0)
+		return LoudnessMeter::minLoudness;
+
+	auto relativeGate = LoudnessMeter::powerToLoudness(absoluteGated) - 10.0f;
+
+	return LoudnessMeter::powerToLoudness(momentaryBlocks.getMeanPower(juce::jmax(relativeGate, LoudnessHistogram::absoluteGate)));
+}
+
+float LoudnessIntegrator::getLoudnessRange() const
+{
+	auto absoluteGated = shortTermValues.getMeanPower(LoudnessHistogram::absoluteGate);
+
+	if (absoluteGated <= 0.0)
+		return 0.0f;
+
+	auto relativeGate = juce::jmax(LoudnessMeter::powerToLoudness(absoluteGated) - 20.0f, LoudnessHistogram::absoluteGate);
+
+	return shortTermValues.getPercentile(relativeGate, 0.95) - shortTermValues.getPercentile(relativeGate, 0.10);
+}
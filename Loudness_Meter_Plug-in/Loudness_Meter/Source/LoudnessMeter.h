@@ -0,0 +1,164 @@
+/*
+  ==============================================================================
+
+    ITU-R BS.1770-4 / EBU R128 loudness measurement.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+/**
+ K-weighted, channel-weighted loudness of up to maxChannels channels.
+ Mean squares are collected on a 100 ms grid, the momentary (400 ms) and
+ short-term (3 s) loudness are updated on every grid step and published through
+ atomics, so any thread can read them without locking.
+
+ The two K-weighting biquads run with the channels side by side in one array,
+ so every statement of the filter loop works on all channels at once.
+ */
+class LoudnessMeter
+{
+public:
+	static constexpr int maxChannels = 12;
+	static constexpr float minLoudness = -120.0f;
+
+	/** Mean squares at the end of one 100 ms step. */
+	struct Step
+	{
+		double momentaryPower = 0.0;
+		double shortTermPower = 0.0;
+		bool momentaryComplete = false;   //a full 400 ms went in since the last reset
+		bool shortTermComplete = false;   //a full 3 s went in since the last reset
+	};
+
+	struct Listener
+	{
+		virtual ~Listener() = default;
+		/** Called on the audio thread after every 100 ms step. */
+		virtual void loudnessStepFinished(const Step& step) = 0;
+	};
+
+	LoudnessMeter();
+
+	/** Not thread safe, set it up before the audio starts. */
+	void setListener(Listener* newListener) { listener = newListener; }
+
+	/** Recomputes the filters for sampleRate and clears all state. */
+	void prepare(double sampleRate, int numChannels);
+	void reset();
+
+	/** BS.1770 weight of one channel, 1.0 by default. */
+	void setChannelWeight(int channel, float weight);
+	/** BS.1770-4 table 3: 0 for LFE, 1.41 for surrounds between 60 and 120 degrees. */
+	static float getChannelWeight(juce::AudioChannelSet::ChannelType type);
+
+	/** Audio thread, uses the first numChannels channels of buffer. */
+	void process(const juce::AudioBuffer<float>& buffer);
+	//==============================================================================
+	float getMomentaryLoudness() const { return momentaryLoudness.load(std::memory_order_relaxed); }
+	float getShortTermLoudness() const { return shortTermLoudness.load(std::memory_order_relaxed); }
+
+	static float powerToLoudness(double power);
+private:
+	struct Biquad
+	{
+		double b0 = 1.0, b1 = 0.0, b2 = 0.0, a1 = 0.0, a2 = 0.0;
+	};
+
+	static constexpr int stepsPerMomentary = 4;     //400 ms
+	static constexpr int stepsPerShortTerm = 30;    //3 s
+	static constexpr int maxChunkSize = 64;
+
+	void processChunk(const float* const* channels, int startSample, int numSamples);
+	void finishStep();
+
+	Biquad preFilter, rlbFilter;
+
+	int numChannels = 0;
+	int numLanes = 0;
+	int samplesPerStep = 4800;
+	int samplesInStep = 0;
+
+	alignas(32) double weights[maxChannels];
+	alignas(32) double preState1[maxChannels];
+	alignas(32) double preState2[maxChannels];
+	alignas(32) double rlbState1[maxChannels];
+	alignas(32) double rlbState2[maxChannels];
+	alignas(32) double stepSum[maxChannels];
+	alignas(32) double interleaved[maxChunkSize * maxChannels];
+
+	std::array<double, stepsPerShortTerm> stepPowers;
+	int stepIndex = 0;
+	int stepsSinceReset = 0;
+
+	Listener* listener = nullptr;
+
+	std::atomic<float> momentaryLoudness{ minLoudness };
+	std::atomic<float> shortTermLoudness{ minLoudness };
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(LoudnessMeter)
+};
+
+//==============================================================================
+/**
+ Loudness values bucketed into fixed 0.01 LU bins between the absolute gate and
+ maxLoudness. Adding a value is O(1), every query walks the bins once, and the
+ memory stays the same however long the measurement runs.
+
+ Only the audio thread adds or clears. The counts are atomics, so a reader on
+ another thread sees a slightly stale histogram but never a torn one.
+ */
+class LoudnessHistogram
+{
+public:
+	static constexpr float absoluteGate = -70.0f;
+	static constexpr float maxLoudness = 10.0f;
+	static constexpr int binsPerLU = 100;
+	static constexpr int numBins = (int)(maxLoudness - absoluteGate) * binsPerLU;
+
+	LoudnessHistogram();
+
+	void clear();
+	/** Ignores anything below the absolute gate. */
+	void add(double power);
+
+	/** Power weighted mean of every bin at or above gateLoudness, 0 if there are none. */
+	double getMeanPower(float gateLoudness) const;
+	/** Loudness at the given fraction of the values at or above gateLoudness. */
+	float getPercentile(float gateLoudness, double fraction) const;
+private:
+	static int getBinIndex(float loudness);
+	static float getBinLoudness(int binIndex);
+	static const std::array<double, numBins>& getBinPowers();
+
+	std::unique_ptr<std::atomic<uint32_t>[]> counts;
+};
+
+//==============================================================================
+/**
+ Integrated loudness (BS.1770-4 gating) and loudness range (EBU Tech 3342) over
+ an unlimited measurement time, built on two LoudnessHistograms.
+ Listens to a LoudnessMeter, the getters can be called from any thread.
+ */
+class LoudnessIntegrator : public LoudnessMeter::Listener
+{
+public:
+	/** Audio thread. While paused, steps are ignored. */
+	void setPaused(bool shouldBePaused) { paused.store(shouldBePaused, std::memory_order_relaxed); }
+	bool isPaused() const { return paused.load(std::memory_order_relaxed); }
+	/** Audio thread. */
+	void reset();
+
+	void loudnessStepFinished(const LoudnessMeter::Step& step) override;
+	//==============================================================================
+	float getIntegratedLoudness() const;
+	/** In LU, 0 until there are short-term values above the gates. */
+	float getLoudnessRange() const;
+private:
+	LoudnessHistogram momentaryBlocks;
+	LoudnessHistogram shortTermValues;
+	std::atomic<bool> paused{ false };
+};
@@ -52,82 +52,282 @@ void Loudness_MeterAudioProcessorEditor::resized()
 	grid.performLayout(getLocalBounds());
 }
 
-void PathProducer::process(juce::Rectangle<float> fftBounds, double sampleRate)
+bool PathProducer::process(juce::Rectangle<float> fftBounds, double sampleRate)
 {
-	juce::AudioBuffer<float> tempIncomingBuffer;
-	while (leftChannelFifo->getNumCompleteBuffersAvailable() > 0)
+	for (int ch = 0; ch < numChannels; ++ch)
+		if (!channelFifos[ch]->isPrepared())
+			return false;
+
+	const auto offset = offsetRMS.load();
+
+	//order switches land on a frame boundary, all orders are prebuilt so nothing is allocated
+	const auto order = getOrderForChoice(orderChoice.load());
+	if (stereoFFTDataGenerator != nullptr && order != stereoFFTDataGenerator->getOrder())
+		stereoFFTDataGenerator->changeOrder(order);
+	if (channelFFTDataGenerator != nullptr && order != channelFFTDataGenerator->getOrder())
+		channelFFTDataGenerator->changeOrder(order);
+
+	const auto historySize = historyBuffer.getNumSamples();
+	const auto fftSize = 1 << order;
+
+	//the channels of a pair are always skipped by the same amount so their frames stay aligned
+	auto getNumAvailable = [this]
+	{
+		auto numAvailable = channelFifos[0]->getNumSamplesAvailable();
+		for (int ch = 1; ch < numChannels; ++ch)
+			numAvailable = juce::jmin(numAvailable, channelFifos[ch]->getNumSamplesAvailable());
+		return numAvailable;
+	};
+
+	//after an overflow the ring holds a stale stretch, start over from fresh samples
+	bool overflowed = false;
+	for (int ch = 0; ch < numChannels; ++ch)
+		overflowed = channelFifos[ch]->checkAndClearOverflow() || overflowed;
+
+	//anything older than the history would be overwritten before it is drawn
+	const auto numToSkip = overflowed ? getNumAvailable() : getNumAvailable() - historySize;
+	for (int ch = 0; ch < numChannels; ++ch)
+		channelFifos[ch]->discardSamples(numToSkip);
+
+	while (getNumAvailable() >= hopSize)
 	{
-		if (leftChannelFifo->getAudioBuffer(tempIncomingBuffer))
+		for (int ch = 0; ch < numChannels; ++ch)
 		{
-			auto size = tempIncomingBuffer.getNumSamples();
+			juce::FloatVectorOperations::copy(historyBuffer.getWritePointer(ch, 0),
+				historyBuffer.getReadPointer(ch, hopSize),
+				historySize - hopSize);
 
-			juce::FloatVectorOperations::copy(monoBuffer.getWritePointer(0, 0),
-				monoBuffer.getReadPointer(0, size),
-				monoBuffer.getNumSamples() - size);
+			channelFifos[ch]->pullSamples(historyBuffer.getWritePointer(ch, historySize - hopSize), hopSize);
+		}
 
-			juce::FloatVectorOperations::copy(monoBuffer.getWritePointer(0, monoBuffer.getNumSamples() - size),
-				tempIncomingBuffer.getReadPointer(0, 0),
-				size);
+		//the newest fftSize samples, so a switch to a longer order has a full frame at once
+		if (stereoFFTDataGenerator != nullptr)
+			stereoFFTDataGenerator->produceFFTDataForRendering(historyBuffer.getReadPointer(0, historySize - fftSize),
+				historyBuffer.getReadPointer(1, historySize - fftSize), offset);//-48.0f
+		else
+			channelFFTDataGenerator->produceFFTDataForRendering(historyBuffer.getReadPointer(0, historySize - fftSize), offset);//-48.0f
+	}
 
-			leftChannelFFTDataGenerator.produceFFTDataForRendering(monoBuffer, offsetRMS);//-48.0f
-		}
+	const auto binWidthRMS = sampleRate / double(fftSize);
+
+	auto pullFrame = [this]
+	{
+		return stereoFFTDataGenerator != nullptr ? stereoFFTDataGenerator->getFFTData(fftData[0], fftData[1])
+												 : channelFFTDataGenerator->getFFTData(fftData[0]);
+	};
+
+	while (pullFrame())
+	{
+		for (int ch = 0; ch < numChannels; ++ch)
+			pathProducer[ch].generatePath(fftData[ch], fftBounds, fftSize, binWidthRMS, offset);//-48.0f
 	}
 
-	const auto fftSizeRMS = leftChannelFFTDataGenerator.getFFTSize();
-	const auto binWidthRMS = sampleRate / double(fftSizeRMS);
+	bool newPaths = false;
 
-	while (leftChannelFFTDataGenerator.getNumAvailableFFTDataBlocks() > 0)
+	for (int ch = 0; ch < numChannels; ++ch)
 	{
-		std::vector<float> fftDataRMS;
-		if (leftChannelFFTDataGenerator.getFFTData(fftDataRMS))
+		while (pathProducer[ch].getNumPathsAvailable() > 0)
 		{
-			pathProducer.generatePath(fftDataRMS, fftBounds, fftSizeRMS, binWidthRMS, offsetRMS);//-48.0f
+			newPaths = pathProducer[ch].getPath(channelFFTPaths[ch]) || newPaths;
 		}
 	}
 
-	while (pathProducer.getNumPathsAvailable() > 0)
+	return newPaths;
+}
+
+//==============================================================================
+AnalysisWorker::AnalysisWorker(Loudness_MeterAudioProcessor& p) : juce::Thread("Analysis"), audioPrc(p),
+																   spectrogramRenderer(1024, 1024)
+{
+	spectrogramColumn.resize((size_t)audioPrc.stftEngine.getNumBins(), 0.0f);
+	updatePathProducers();
+}
+
+AnalysisWorker::~AnalysisWorker()
+{
+	stop();
+}
+
+void AnalysisWorker::start()
+{
+	//attaching the RMS feed empties the rings, whatever was left predates this reader
+	audioPrc.addAnalysisConsumer(viewFeeds);
+	startThread();
+}
+
+void AnalysisWorker::stop()
+{
+	stopThread(1000);
+	audioPrc.removeAnalysisConsumer(viewFeeds);
+}
+
+void AnalysisWorker::setView(View newView)
+{
+	view.store(newView);
+
+	//the ballistics view reads the always-on meters only
+	using Processor = Loudness_MeterAudioProcessor;
+	const int feeds = newView == rmsView ? Processor::rmsFeed
+					: newView == spectrogramView ? Processor::stftFeed : 0;
+
+	if (isThreadRunning())
 	{
-		pathProducer.getPath(leftChannelFFTPath);
+		audioPrc.removeAnalysisConsumer(viewFeeds & ~feeds);
+		audioPrc.addAnalysisConsumer(feeds & ~viewFeeds);
 	}
+
+	viewFeeds = feeds;
 }
 
-void ImageProducer::process(double sampleRate)
+void AnalysisWorker::setRMSBounds(juce::Rectangle<int> bounds)
 {
-	juce::AudioBuffer<float> tempIncomingBuffer;
-	while(spectrChannelFifo->getNumCompleteBuffersAvailable() > 0)
+	boundsX.store(bounds.getX());
+	boundsY.store(bounds.getY());
+	boundsWidth.store(bounds.getWidth());
+	boundsHeight.store(bounds.getHeight());
+}
+
+void AnalysisWorker::setSpectrogramParameters(float lvlKnob, float skProp, float lvlOff)
+{
+	lvlKnobSpectr.store(lvlKnob);
+	skPropSpectr.store(skProp);
+	lvlOffSpectr.store(lvlOff);
+}
+
+void AnalysisWorker::run()
+{
+	while (!threadShouldExit())
 	{
-		if(spectrChannelFifo->getAudioBuffer(tempIncomingBuffer))
-		{
-			auto size = tempIncomingBuffer.getNumSamples();
+		const auto currentView = view.load();
+		const auto sampleRate = audioPrc.getSampleRate();
 
-			juce::FloatVectorOperations::copy(monoBuffer.getWritePointer(0, 0),
-				monoBuffer.getReadPointer(0, size),
-				monoBuffer.getNumSamples() - size);
+		//only the analyzers of the visible view run, the others catch up from
+		//the newest samples when they are shown again. While the input is silent
+		//the feeds are paused, so after draining what is left nothing new is produced
+		if (currentView == rmsView)
+		{
+			//prepareToPlay resizes and resets the rings, it waits until this pass is done
+			const juce::ScopedLock sl(audioPrc.getAnalysisReadLock());
 
-			juce::FloatVectorOperations::copy(monoBuffer.getWritePointer(0, monoBuffer.getNumSamples() - size),
-				tempIncomingBuffer.getReadPointer(0, 0),
-				size);
+			if (numPathChannels != audioPrc.getNumAnalysisChannels())
+				updatePathProducers();
 
-			spectrChannelFFTDataGenerator.produceFFTDataForRendering(monoBuffer, 0.0f);
+			processPaths(sampleRate);
 		}
+
+		processSpectrogram(currentView == spectrogramView);
+
+		wait(pollIntervalMs);
 	}
+}
 
-	const auto fftSizeSpectr = spectrChannelFFTDataGenerator.getFFTSize();
-	const auto binWidthSpectr = sampleRate / double(fftSizeSpectr);
+//channels of the current bus layout in pairs, each pair shares one packed FFT
+void AnalysisWorker::updatePathProducers()
+{
+	numPathChannels = audioPrc.getNumAnalysisChannels();
+	pathProducers.clear();
 
-	while(spectrChannelFFTDataGenerator.getNumAvailableFFTDataBlocks() > 0)
+	for (int ch = 0; ch < numPathChannels; ch += 2)
 	{
-		std::vector<float> fftDataSpectr;
-		if(spectrChannelFFTDataGenerator.getFFTData(fftDataSpectr))
-		{ 
-			imageProducer.generateImage(fftDataSpectr, spectrChannelFFTImage, fftSizeSpectr, binWidthSpectr, 0.0f);
-		}
+		auto* second = ch + 1 < numPathChannels ? audioPrc.channelFifos.getUnchecked(ch + 1) : nullptr;
+		pathProducers.add(new PathProducer(*audioPrc.channelFifos.getUnchecked(ch), second));
+	}
+}
+
+void AnalysisWorker::processPaths(double sampleRate)
+{
+	const juce::Rectangle<float> fftBounds((float)boundsX.load(), (float)boundsY.load(),
+										   (float)boundsWidth.load(), (float)boundsHeight.load());
+
+	if (fftBounds.isEmpty())
+		return;
+
+	bool newPaths = false;
+
+	for (auto* pathProducer : pathProducers)
+	{
+		pathProducer->offsetRMS = rmsOffset.load();
+		pathProducer->setOrderChoice(orderChoice.load());
+
+		newPaths = pathProducer->process(fftBounds, sampleRate) || newPaths;
 	}
 
-	//while(imageProducer.getNumImagesAvailable() > 0)
-	//{
-	//	imageProducer.getImage(spectrChannelFFTImage);
-	//}
+	if (!newPaths)
+		return;
+
+	auto& paths = pathFrames.getWriteBuffer();
+	paths.resize((size_t)numPathChannels);
+
+	size_t channel = 0;
+	for (auto* pathProducer : pathProducers)
+		for (int ch = 0; ch < pathProducer->getNumChannels(); ++ch)
+			paths[channel++] = pathProducer->getPath(ch);
+
+	pathFrames.publish();
+}
+
+void AnalysisWorker::processSpectrogram(bool isVisible)
+{
+	//one column per STFT hop, hidden columns are only drained
+	bool newColumns = false;
+
+	while (audioPrc.stftEngine.getColumn(spectrogramColumn))
+	{
+		if (!isVisible)
+			continue;
+
+		spectrogramRenderer.drawNextLineOfSpectrogram(spectrogramColumn, lvlKnobSpectr.load(), skPropSpectr.load(), lvlOffSpectr.load());
+		++numColumnsWritten;
+		newColumns = true;
+	}
+
+	if (newColumns)
+		publishSpectrogram();
+}
+
+//copies numColumns columns starting at firstColumn, wrapping round the right hand edge
+static void copySpectrogramColumns(const juce::Image& source, juce::Image& dest, int firstColumn, int numColumns)
+{
+	const int width = source.getWidth();
+	firstColumn = ((firstColumn % width) + width) % width;
+
+	const juce::Image::BitmapData src(source, juce::Image::BitmapData::readOnly);
+	juce::Image::BitmapData dst(dest, juce::Image::BitmapData::writeOnly);
+
+	jassert(src.pixelFormat == dst.pixelFormat);
+
+	const int firstRun = juce::jmin(numColumns, width - firstColumn);
+
+	for (int y = 0; y < src.height; ++y)
+	{
+		memcpy(dst.getPixelPointer(firstColumn, y), src.getPixelPointer(firstColumn, y), (size_t)(firstRun * src.pixelStride));
+
+		if (numColumns > firstRun)
+			memcpy(dst.getLinePointer(y), src.getLinePointer(y), (size_t)((numColumns - firstRun) * src.pixelStride));
+	}
+}
+
+void AnalysisWorker::publishSpectrogram()
+{
+	const auto& source = spectrogramRenderer.getImage();
+	auto& frame = spectrogramFrames.getWriteBuffer();
+
+	//each of the three frames is allocated once, the first time it comes round
+	if (!frame.image.isValid())
+	{
+		frame.image = juce::Image(source.getFormat(), source.getWidth(), source.getHeight(), true);
+		frame.numColumnsWritten = 0;
+	}
+
+	//a frame only misses the columns written since it was last published,
+	//so the copy stays O(height) per column instead of the whole image
+	const auto numMissing = (int)juce::jmin<juce::int64>(source.getWidth(), numColumnsWritten - frame.numColumnsWritten);
+	copySpectrogramColumns(source, frame.image, spectrogramRenderer.getNextColumn() - numMissing, numMissing);
+
+	frame.nextColumn = spectrogramRenderer.getNextColumn();
+	frame.numColumnsWritten = numColumnsWritten;
+
+	spectrogramFrames.publish();
 }
 
 void Loudness_MeterAudioProcessorEditor::knobAttachment(int knobId)
@@ -10,169 +10,7 @@
 
 #include <JuceHeader.h>
 #include "PluginProcessor.h"
-
-enum FFTOrder
-{
-	order2048 = 11,
-	order4096 = 12,
-	order8192 = 13
-};
-
-template<typename BlockType>
-struct FFTDataGeneratorRMS
-{
-	/**
-	 produces the FFT data from an audio buffer.
-	 */
-	void produceFFTDataForRendering(const juce::AudioBuffer<float>& audioData, const float negativeInfinity)
-	{
-		const auto fftSize = getFFTSize();
-
-		fftData.assign(fftData.size(), 0);
-		auto* readIndex = audioData.getReadPointer(0);
-		std::copy(readIndex, readIndex + fftSize, fftData.begin());
-
-		// first apply a windowing function to our data
-		window->multiplyWithWindowingTable(fftData.data(), fftSize);       
-
-		// then render our FFT data..
-		forwardFFT->performFrequencyOnlyForwardTransform(fftData.data());  
-
-		int numBins = (int)fftSize / 2;
-
-		//normalize the fft values.
-		for (int i = 0; i < numBins; ++i)
-		{
-			auto v = fftData[i];
-			//            fftData[i] /= (float) numBins;
-			if (!std::isinf(v) && !std::isnan(v))
-			{
-				v /= float(numBins);
-			}
-			else
-			{
-				v = 0.f;
-			}
-			fftData[i] = v;
-		}
-
-		//convert them to decibels
-		for (int i = 0; i < numBins; ++i)
-		{
-			fftData[i] = juce::Decibels::gainToDecibels(fftData[i], negativeInfinity);
-		}
-
-		fftDataFifo.push(fftData);
-	}
-
-	void changeOrder(FFTOrder newOrder)
-	{
-		//when you change order, recreate the window, forwardFFT, fifo, fftData
-		//also reset the fifoIndex
-		//things that need recreating should be created on the heap via std::make_unique<>
-
-		order = newOrder;
-		auto fftSize = getFFTSize();
-
-		forwardFFT = std::make_unique<juce::dsp::FFT>(order);
-		window = std::make_unique<juce::dsp::WindowingFunction<float>>(fftSize, juce::dsp::WindowingFunction<float>::blackmanHarris);
-
-		fftData.clear();
-		fftData.resize(fftSize * 2, 0);
-
-		fftDataFifo.prepare(fftData.size());
-	}
-	//==============================================================================
-	int getFFTSize() const { return 1 << order; }
-	int getNumAvailableFFTDataBlocks() const { return fftDataFifo.getNumAvailableForReading(); }
-	//==============================================================================
-	bool getFFTData(BlockType& fftData) { return fftDataFifo.pull(fftData); }
-private:
-	FFTOrder order;
-	BlockType fftData;
-	std::unique_ptr<juce::dsp::FFT> forwardFFT;
-	std::unique_ptr<juce::dsp::WindowingFunction<float>> window;
-
-	Fifo<BlockType> fftDataFifo;
-};
-
-template<typename BlockType>
-struct FFTDataGeneratorSpectr
-{
-	/**
-	 produces the FFT data from an audio buffer.
-	 */
-	void produceFFTDataForRendering(const juce::AudioBuffer<float>& audioData, const float negativeInfinity)
-	{
-		const auto fftSize = getFFTSize();
-
-		fftData.assign(fftData.size(), 0);
-		auto* readIndex = audioData.getReadPointer(0);
-		std::copy(readIndex, readIndex + fftSize, fftData.begin());
-
-		// first apply a windowing function to our data
-		window->multiplyWithWindowingTable(fftData.data(), fftSize);
-
-		// then render our FFT data..
-		forwardFFT->performFrequencyOnlyForwardTransform(fftData.data());  
-
-		int numBins = (int)fftSize / 2;
-
-		//normalize the fft values.
-		for (int i = 0; i < numBins; ++i)
-		{
-			auto v = fftData[i];
-			//            fftData[i] /= (float) numBins;
-			if (!std::isinf(v) && !std::isnan(v))
-			{
-				v /= float(numBins);
-			}
-			else
-			{
-				v = 0.f;
-			}
-			fftData[i] = v;
-		}
-
-		//convert them to decibels
-		for (int i = 0; i < numBins; ++i)
-		{
-			fftData[i] = juce::Decibels::gainToDecibels(fftData[i], negativeInfinity);
-		}
-
-		fftDataFifo.push(fftData);
-	}
-
-	void changeOrder(FFTOrder newOrder)
-	{
-		//when you change order, recreate the window, forwardFFT, fifo, fftData
-		//also reset the fifoIndex
-		//things that need recreating should be created on the heap via std::make_unique<>
-
-		order = newOrder;
-		auto fftSize = getFFTSize();
-
-		forwardFFT = std::make_unique<juce::dsp::FFT>(order);
-		window = std::make_unique<juce::dsp::WindowingFunction<float>>(fftSize, juce::dsp::WindowingFunction<float>::hann);
-		
-		fftData.clear();
-		fftData.resize(fftSize * 2, 0);
-
-		fftDataFifo.prepare(fftData.size());
-	}
-	//==============================================================================
-	int getFFTSize() const { return 1 << order; }
-	int getNumAvailableFFTDataBlocks() const { return fftDataFifo.getNumAvailableForReading(); }
-	//==============================================================================
-	bool getFFTData(BlockType& fftData) { return fftDataFifo.pull(fftData); }
-private:
-	FFTOrder order;
-	BlockType fftData;
-	std::unique_ptr<juce::dsp::FFT> forwardFFT;
-	std::unique_ptr<juce::dsp::WindowingFunction<float>> window;
-
-	Fifo<BlockType> fftDataFifo;
-};
+#include "FFTDataGenerator.h"
 
 template<typename PathType>
 struct AnalyzerPathGenerator
@@ -185,9 +23,10 @@ struct AnalyzerPathGenerator
 	{
 		auto top = fftBounds.getY();
 		auto bottom = fftBounds.getHeight();
-		auto width = fftBounds.getWidth();
 
-		int numBins = (int)fftSize / 2;
+		//the log frequency axis only moves with the bounds, the order or the sample rate
+		if (fftBounds != cachedBounds || fftSize != cachedFFTSize || binWidth != cachedBinWidth)
+			updateColumnSpans(fftBounds, fftSize, binWidth);
 
 		PathType p;
 		p.preallocateSpace(3 * (int)fftBounds.getWidth());
@@ -206,18 +45,31 @@ struct AnalyzerPathGenerator
 
 		p.startNewSubPath(0, y);
 
-		const int pathResolution = 1; //you can draw line-to's every 'pathResolution' pixels.
-
-		for (int binNum = 1; binNum < numBins; binNum += pathResolution)
+		//at most two vertices per pixel column, the lowest and the highest bin in the order they occur
+		for (const auto& span : columnSpans)
 		{
-			y = map(renderData[binNum]);
+			int first = span.firstBin, second = span.firstBin;
 
-			if (!std::isnan(y) && !std::isinf(y))
+			for (int binNum = span.firstBin + 1; binNum < span.endBin; ++binNum)
 			{
-				auto binFreq = binNum * binWidth;
-				auto normalizedBinX = juce::mapFromLog10(binFreq, 20.f, 20000.f);
-				int binX = std::floor(normalizedBinX * width);
-				p.lineTo(binX, y);
+				if (renderData[binNum] < renderData[first])
+					first = binNum;
+				else if (renderData[binNum] > renderData[second])
+					second = binNum;
+			}
+
+			if (second < first)
+				std::swap(first, second);
+
+			for (auto binNum : { first, second })
+			{
+				y = map(renderData[binNum]);
+
+				if (!std::isnan(y) && !std::isinf(y))
+					p.lineTo((float)span.x, y);
+
+				if (first == second)
+					break;
 			}
 		}
 
@@ -234,146 +86,376 @@ struct AnalyzerPathGenerator
 		return pathFifo.pull(path);
 	}
 private:
+	//consecutive bins that land on the same pixel column
+	struct ColumnSpan
+	{
+		int x, firstBin, endBin;
+	};
+
+	void updateColumnSpans(juce::Rectangle<float> fftBounds, int fftSize, float binWidth)
+	{
+		cachedBounds = fftBounds;
+		cachedFFTSize = fftSize;
+		cachedBinWidth = binWidth;
+
+		const auto width = fftBounds.getWidth();
+		const int numBins = fftSize / 2;
+
+		columnSpans.clear();
+		columnSpans.reserve((size_t)width + 2);
+
+		for (int binNum = 1; binNum < numBins; ++binNum)
+		{
+			auto binFreq = binNum * binWidth;
+			auto normalizedBinX = juce::mapFromLog10(binFreq, 20.f, 20000.f);
+			int binX = (int)std::floor(normalizedBinX * width);
+
+			if (!columnSpans.empty() && columnSpans.back().x == binX)
+			{
+				columnSpans.back().endBin = binNum + 1;
+				continue;
+			}
+
+			//one column past the right hand edge, so the line runs all the way to it
+			if (!columnSpans.empty() && columnSpans.back().x > width)
+				break;
+
+			columnSpans.push_back({ binX, binNum, binNum + 1 });
+		}
+	}
+
 	Fifo<PathType> pathFifo;
+
+	juce::Rectangle<float> cachedBounds;
+	int cachedFFTSize = 0;
+	float cachedBinWidth = 0.0f;
+	std::vector<ColumnSpan> columnSpans;
 };
 
-template<typename ImageType>
-struct AnalyzerImageGenerator
+/**
+ Writes one spectrogram column straight into an image's BitmapData.
+ The skewed row-to-bin table and the HSL palette are only rebuilt when their
+ inputs change, so a column is a table lookup and a multiply per pixel row.
+ */
+struct SpectrogramColumnPainter
 {
-public:
+	static constexpr int paletteSize = 2048;
 
-	void generateImage(const std::vector<float>& renderData, juce::Image mainImage, int fftSize, float binWidth, float negativeInfinity)
+	/** Row i shows bin (1 - (i / height)^skew) * binScale, clamped to [0, maxBin]. */
+	void prepareRows(int imageHeight, float binScale, int maxBin, float skew)
 	{
-		auto rightHandEdge = mainImage.getWidth() - 1;
-		auto imageHeight = mainImage.getHeight();
+		if (imageHeight == rowsHeight && binScale == rowsBinScale && maxBin == rowsMaxBin && skew == rowsSkew)
+			return;
 
-		int numBins = fftSize / 2; 
+		rowsHeight = imageHeight;
+		rowsBinScale = binScale;
+		rowsMaxBin = maxBin;
+		rowsSkew = skew;
 
-		ImageType image;
-		mainImage.moveImageSection(0, 0, 1, 0, rightHandEdge, imageHeight);
+		rowToBin.resize((size_t)juce::jmax(0, imageHeight));
 
-		juce::Range<float> maxLevel = juce::FloatVectorOperations::findMinAndMax(renderData.data(), numBins);
+		for (int i = 1; i < imageHeight; ++i)
+		{
+			const float skewedProportionY = 1.0f - std::exp(std::log(i / (float)imageHeight) * skew);
+			rowToBin[(size_t)i] = juce::jlimit(0, maxBin, (int)(skewedProportionY * binScale));
+		}
+	}
 
-		if (maxLevel.getEnd() == 0.0f)
-			maxLevel.setEnd(0.0000001f);
+	/**
+	 Colour::fromHSL(level, 1, level) for levels from minLevel to maxLevel.
+	 'silentPeak' stands in for the column peak when a column is all zeros.
+	 */
+	void preparePalette(float minLevel, float maxLevel, float silentPeak)
+	{
+		columnSilentPeak = silentPeak;
 
-		for (int i = 1; i < imageHeight; ++i)
+		if (minLevel == paletteMin && maxLevel == paletteMax)
+			return;
+
+		paletteMin = minLevel;
+		paletteMax = maxLevel;
+
+		for (int i = 0; i < paletteSize; ++i)
 		{
-			const float skewedProportionY = 1.0f - std::exp(std::log(i / (float)imageHeight) * 0.2f);//0.2f
-			const int fftDataIndex = juce::jlimit((int)negativeInfinity, numBins, (int)(skewedProportionY * numBins));
+			const float level = juce::jmap((float)i, 0.0f, (float)(paletteSize - 1), minLevel, maxLevel);
+			palette[(size_t)i] = juce::Colour::fromHSL(level, 1.0f, level, 1.0f).getPixelARGB();
+		}
+	}
 
-			const float level = juce::jmap(renderData[fftDataIndex], negativeInfinity, maxLevel.getEnd(), negativeInfinity, 3.9f);//Original targetRangeMax = 3.9f, needs to be tweaked/tested
+	/**
+	 Column x of 'image' from the bins in 'data', at least maxBin + 1 of them.
+	 Values from minLevel up to the peak of the shown bins span the whole palette.
+	 */
+	void drawColumn(juce::Image& image, int x, const float* data)
+	{
+		jassert(image.getHeight() == rowsHeight);
+
+		juce::Image::BitmapData bitmap(image, x, 0, 1, rowsHeight, juce::Image::BitmapData::writeOnly);
+
+		auto peak = juce::FloatVectorOperations::findMaximum(data, rowsMaxBin + 1);
+		if (peak == 0.0f)
+			peak = columnSilentPeak;
 
-			mainImage.setPixelAt(rightHandEdge, i, juce::Colour::fromHSL(level, 1.0f, level, 1.0f));//Colour::fromHSV
+		const float scale = (float)(paletteSize - 1) / (peak - paletteMin);
+		const float maxIndex = (float)(paletteSize - 1);
+
+		auto colourForRow = [&](int i)
+		{
+			//NaN falls through to the first entry
+			const float index = (data[rowToBin[(size_t)i]] - paletteMin) * scale;
+			return palette[(size_t)(index > 0.0f ? (index < maxIndex ? index : maxIndex) : 0.0f)];
+		};
+
+		if (bitmap.pixelFormat == juce::Image::RGB)
+		{
+			for (int i = 1; i < rowsHeight; ++i)
+				reinterpret_cast<juce::PixelRGB*>(bitmap.getLinePointer(i))->set(colourForRow(i));
+		}
+		else
+		{
+			for (int i = 1; i < rowsHeight; ++i)
+				reinterpret_cast<juce::PixelARGB*>(bitmap.getLinePointer(i))->set(colourForRow(i));
 		}
+	}
+	/**
+	 Draws a circular spectrogram store into 'area' as two blits, oldest column first.
+	 'nextColumn' is the column the next write goes to, i.e. the oldest one.
+	 */
+	static void drawScrolled(juce::Graphics& g, const juce::Image& image, int nextColumn, juce::Rectangle<int> area)
+	{
+		const int width = image.getWidth();
+		const int height = image.getHeight();
+
+		if (width <= 0 || area.isEmpty())
+			return;
 
-		/*imageFifo.push(mainImage);*/
+		const int numOld = width - nextColumn;
+		const int splitX = area.getX() + juce::roundToInt(area.getWidth() * (numOld / (float)width));
+
+		g.drawImage(image, area.getX(), area.getY(), splitX - area.getX(), area.getHeight(), nextColumn, 0, numOld, height);
+
+		if (nextColumn > 0)
+			g.drawImage(image, splitX, area.getY(), area.getRight() - splitX, area.getHeight(), 0, 0, nextColumn, height);
 	}
+private:
+	std::vector<int> rowToBin;
+	int rowsHeight = -1, rowsMaxBin = -1;
+	float rowsBinScale = -1.0f, rowsSkew = -1.0f;
+
+	std::array<juce::PixelARGB, paletteSize> palette;
+	float paletteMin = 0.0f, paletteMax = -1.0f;
+	float columnSilentPeak = 1.0f;
+};
+
+/**
+ Scrolling spectrogram. Columns go into a circular image at a moving write
+ column, so adding one costs a single column instead of moving the whole image;
+ draw() puts the newest column at the right hand edge.
+ */
+struct SpectrogramRenderer
+{
+	SpectrogramRenderer(int width, int height) : spectrogramImage(juce::Image::RGB, width, height, true) {}
+
+	void drawNextLineOfSpectrogram(const std::vector<float>& spectrogramColumn, float lvlKnobSpectr, float skPropSpectr, float lvlOffSpectr)
+	{
+		const int imageHeight = spectrogramImage.getHeight();
+
+		const auto* fftData = spectrogramColumn.data();
+		const int maxBin = (int)spectrogramColumn.size() - 1;
 
-	//int getNumImagesAvailable() const
-	//{
-	//	return imageFifo.getNumAvailableForReading();
-	//}
+		columnPainter.prepareRows(imageHeight, (float)maxBin, maxBin, skPropSpectr);//0.2f
+		columnPainter.preparePalette(0.0f, lvlOffSpectr, lvlKnobSpectr);//lvlKnobSpectr 0.00001f, Original targetRangeMax = 3.9f
+		columnPainter.drawColumn(spectrogramImage, nextColumn, fftData);
 
-	//bool getImage(ImageType& image)
-	//{
-	//	return imageFifo.pull(image);
-	//}
+		nextColumn = (nextColumn + 1) % spectrogramImage.getWidth();
+	}
+
+	void draw(juce::Graphics& g, juce::Rectangle<int> area) const
+	{
+		SpectrogramColumnPainter::drawScrolled(g, spectrogramImage, nextColumn, area);
+	}
 
+	/** The circular store itself, its oldest column is getNextColumn(). */
+	const juce::Image& getImage() const { return spectrogramImage; }
+	int getNextColumn() const { return nextColumn; }
 private:
-	Fifo<ImageType> imageFifo;
+	juce::Image spectrogramImage;
+	SpectrogramColumnPainter columnPainter;
+	int nextColumn = 0;
 };
 
 struct PathProducer
 {
 public:
 
-	PathProducer(SingleChannelSampleFifo<juce::AudioBuffer<float>>& scsf) : leftChannelFifo(&scsf), offsetRMS(-48.0f), orderChoice(0)
+	/**
+	 One channel, or with 'second' a pair of channels that share one packed
+	 complex FFT per frame.
+	 */
+	PathProducer(SingleChannelSampleFifo<juce::AudioBuffer<float>>& first,
+				 SingleChannelSampleFifo<juce::AudioBuffer<float>>* second = nullptr) : offsetRMS(-48.0f)
 	{
+		channelFifos[0] = &first;
+		channelFifos[1] = second;
+		numChannels = second != nullptr ? 2 : 1;
+
 		//48000 / 2048 = 23hz, a lot of resolution in the upper end, not a lot in the bottom
-		switch (orderChoice)
+		//every order is built here, so switching later never allocates
+		if (numChannels == 2)
+		{
+			stereoFFTDataGenerator = std::make_unique<StereoFFTDataGeneratorRMS<std::vector<float>>>();
+			stereoFFTDataGenerator->prepareAllOrders();
+		}
+		else
+		{
+			channelFFTDataGenerator = std::make_unique<FFTDataGeneratorRMS<std::vector<float>>>();
+			channelFFTDataGenerator->prepareAllOrders();
+		}
+
+		//always the newest maxFFTSize samples, whatever order is selected
+		historyBuffer.setSize(numChannels, FFTDataGeneratorRMS<std::vector<float>>::maxFFTSize);
+		historyBuffer.clear();
+	}
+
+	/** True if a new path arrived for at least one channel. */
+	bool process(juce::Rectangle<float> fftBounds, double sampleRate);
+	int getNumChannels() const { return numChannels; }
+	juce::Path getPath(int channel = 0) { return channelFFTPaths[channel]; }
+
+	/** Any thread, takes effect at the next frame: 0 = 2048, 1 = 4096, 2 = 8192. */
+	void setOrderChoice(int choice) { orderChoice.store(choice); }
+	static FFTOrder getOrderForChoice(int choice)
+	{
+		switch (choice)
 		{
 		case 0:
-			leftChannelFFTDataGenerator.changeOrder(FFTOrder::order2048);
-			break;
+			return FFTOrder::order2048;
 		case 1:
-			leftChannelFFTDataGenerator.changeOrder(FFTOrder::order4096);
-			break;
+			return FFTOrder::order4096;
 		case 2:
-			leftChannelFFTDataGenerator.changeOrder(FFTOrder::order8192);
-			break;
+			return FFTOrder::order8192;
 		default:
 			jassertfalse;
-			break;
+			return FFTOrder::order2048;
 		}
-		monoBuffer.setSize(1, leftChannelFFTDataGenerator.getFFTSize());
 	}
 
-	void process(juce::Rectangle<float> fftBounds, double sampleRate);
-	juce::Path getPath() { return leftChannelFFTPath; }
+	//set from the message thread, read by the analysis thread
+	std::atomic<float> offsetRMS;
 
-	int orderChoice;
-	float offsetRMS;
+	//samples the analysis advances per FFT frame, independent of the host block size
+	static constexpr int hopSize = 512;
 
 private:
 
 	using BlockType = juce::AudioBuffer<float>;
-	SingleChannelSampleFifo<BlockType>* leftChannelFifo;
+	SingleChannelSampleFifo<BlockType>* channelFifos[2] = {};
+	int numChannels = 1;
 
-	juce::AudioBuffer<float> monoBuffer;
+	std::atomic<int> orderChoice{ 0 };
 
-	FFTDataGeneratorRMS<std::vector<float>> leftChannelFFTDataGenerator;
+	BlockType historyBuffer;
 
-	AnalyzerPathGenerator<juce::Path> pathProducer;
+	std::unique_ptr<FFTDataGeneratorRMS<std::vector<float>>> channelFFTDataGenerator;
+	std::unique_ptr<StereoFFTDataGeneratorRMS<std::vector<float>>> stereoFFTDataGenerator;
+	std::vector<float> fftData[2];
 
-	juce::Path leftChannelFFTPath;
+	AnalyzerPathGenerator<juce::Path> pathProducer[2];
+
+	juce::Path channelFFTPaths[2];
 };
 
-struct ImageProducer
+/**
+ Runs the RMS and spectrogram analyzers on their own thread, so the message thread
+ only paints. Finished paths and spectrogram frames are handed over through
+ TripleBuffers: the editor picks up the newest one and neither side ever waits.
+ */
+struct AnalysisWorker : private juce::Thread
 {
-public:
+	enum View
+	{
+		rmsView,
+		spectrogramView,
+		ballisticsView
+	};
 
-	ImageProducer(SingleChannelSampleFifo<juce::AudioBuffer<float>>& scsf) : spectrChannelFifo(&scsf), 
-																			 spectrChannelFFTImage(juce::Image::RGB, 512, 512, true)
+	struct SpectrogramFrame
 	{
-		spectrChannelFFTDataGenerator.changeOrder(FFTOrder::order2048);
-		monoBuffer.setSize(1, spectrChannelFFTDataGenerator.getFFTSize());
-	}
+		juce::Image image;
+		int nextColumn = 0;
+		juce::int64 numColumnsWritten = 0;
+	};
 
-	void process(double sampleRate);
-	juce::Image getImage() { return spectrChannelFFTImage; }
+	AnalysisWorker(Loudness_MeterAudioProcessor& p);
+	~AnalysisWorker() override;
 
+	void start();
+	void stop();
+
+	//message thread, picked up by the worker before its next pass
+	void setView(View newView);
+	void setRMSBounds(juce::Rectangle<int> bounds);
+	void setRMSOffset(float offset) { rmsOffset.store(offset); }
+	void setOrderChoice(int choice) { orderChoice.store(choice); }
+	void setSpectrogramParameters(float lvlKnob, float skProp, float lvlOff);
+	//==============================================================================
+	//message thread, the get functions return what the last successful pull took over
+	bool pullLatestPaths() { return pathFrames.pullLatest(); }
+	const std::vector<juce::Path>& getPaths() { return pathFrames.getReadBuffer(); }
+
+	bool pullLatestSpectrogram() { return spectrogramFrames.pullLatest(); }
+	const SpectrogramFrame& getSpectrogram() { return spectrogramFrames.getReadBuffer(); }
 private:
+	void run() override;
+	void updatePathProducers();
+	void processPaths(double sampleRate);
+	void processSpectrogram(bool isVisible);
+	void publishSpectrogram();
 
-	using BlockType = juce::AudioBuffer<float>;
-	SingleChannelSampleFifo<BlockType>* spectrChannelFifo;
+	Loudness_MeterAudioProcessor& audioPrc;
 
-	BlockType monoBuffer;
+	juce::OwnedArray<PathProducer> pathProducers;
+	int numPathChannels = 0;
 
-	FFTDataGeneratorSpectr<std::vector<float>> spectrChannelFFTDataGenerator;
+	SpectrogramRenderer spectrogramRenderer;
+	std::vector<float> spectrogramColumn;
+	juce::int64 numColumnsWritten = 0;
 
-	AnalyzerImageGenerator<juce::Image> imageProducer;
-	
-	juce::Image spectrChannelFFTImage;
+	TripleBuffer<std::vector<juce::Path>> pathFrames;
+	TripleBuffer<SpectrogramFrame> spectrogramFrames;
+
+	std::atomic<int> view{ rmsView };
+	//the processor feeds the visible view needs, attached while the thread runs
+	int viewFeeds = 0;
+	//the four may tear during a resize, which only misplaces a single frame
+	std::atomic<int> boundsX{ 0 }, boundsY{ 0 }, boundsWidth{ 0 }, boundsHeight{ 0 };
+	std::atomic<float> rmsOffset{ -48.0f };
+	std::atomic<int> orderChoice{ 0 };
+	std::atomic<float> lvlKnobSpectr{ 0.00001f }, skPropSpectr{ 0.2f }, lvlOffSpectr{ 3.9f };
+
+	//a little under one RMS hop at 48 kHz
+	static constexpr int pollIntervalMs = 10;
 };
 
 struct SpectrogramAndRMSRep : public juce::Component, private juce::Timer
 {
 public:
 
-	SpectrogramAndRMSRep(Loudness_MeterAudioProcessor& p) : audioPrc(p), 
-															forwardFFT(audioPrc.fftOrder), spectrogramImage(juce::Image::RGB, 1024, 1024, true),
-															leftPathProducer(audioPrc.leftChannelFifo), rightPathProducer(audioPrc.rightChannelFifo),
-															spectrImageProducer(audioPrc.spectrChannelFifo)
+	SpectrogramAndRMSRep(Loudness_MeterAudioProcessor& p) : audioPrc(p), analysisWorker(p)
 	{
+		applyParameterSnapshot(audioPrc.getParameterSnapshot());
+		analysisWorker.start();
+
+#if JUCE_MAJOR_VERSION < 7
+		//no VBlankAttachment before JUCE 7, so frames are paced by a timer instead
 		startTimerHz(30);//30
+#endif
 	}
 
 	~SpectrogramAndRMSRep()
 	{
 		stopTimer();
-		myBackgroundsSpectr.clear();
-		myBackgroundsRMS.clear();
+		analysisWorker.stop();
 	}
 
 	void paint(juce::Graphics& g) override
@@ -386,69 +468,265 @@ public:
 
 		g.setOpacity(1.0f);
 		
-		//RMS paths
-		auto leftChannelFFTPath = leftPathProducer.getPath();
-		auto rightChannelFFTPath = rightPathProducer.getPath();
-
-		//Spectr image
-		auto spectrFFTImage = spectrImageProducer.getImage();
-
-		if (isRMS)
+		if (isBallistics)
+		{
+			drawBallistics(g, getAnalysisAreaRMS().reduced(10, 20));
+		}
+		else if (isRMS)
 		{
 
-			for each(auto backround in myBackgroundsRMS)
-			{
-				if (rmsGridChoice == backround.first)
-					g.drawImage(backround.second, getLocalBounds().toFloat());
-			}
+			g.drawImage(getRMSBackground(), getLocalBounds().toFloat());
 
-			leftChannelFFTPath.applyTransform(juce::AffineTransform().translation(responseAreaRMS.getX(), -10.0f));//-10.0f
-			rightChannelFFTPath.applyTransform(juce::AffineTransform().translation(responseAreaRMS.getX(), -10.0f));//-10.0f
+			//RMS paths, one per channel, kept inside the area refreshDisplay() invalidates
+			juce::Graphics::ScopedSaveState clipState(g);
+			g.reduceClipRegion(getDirtyAreaRMS());
 
-			g.setColour(juce::Colours::white);
-			g.strokePath(leftChannelFFTPath, juce::PathStrokeType(1.0f));
+			const auto& channelFFTPaths = analysisWorker.getPaths();
+			for (size_t channel = 0; channel < channelFFTPaths.size(); ++channel)
+			{
+				auto channelFFTPath = channelFFTPaths[channel];
+				channelFFTPath.applyTransform(juce::AffineTransform().translation(responseAreaRMS.getX(), -10.0f));//-10.0f
 
-			g.setColour(juce::Colours::skyblue);
-			g.strokePath(rightChannelFFTPath, juce::PathStrokeType(1.0f));
+				g.setColour(channelColours[channel % juce::numElementsInArray(channelColours)]);
+				g.strokePath(channelFFTPath, juce::PathStrokeType(1.0f));
+			}
 
 			g.setColour(juce::Colours::orange);
 			g.drawRoundedRectangle(responseAreaRMS.toFloat(), 4.0f, 1.0f);
 		}
 		else
 		{
-			g.drawImage(spectrogramImage, responseAreaSpectr.toFloat());//spectrogramImage
+			const auto& spectrogram = analysisWorker.getSpectrogram();
+			SpectrogramColumnPainter::drawScrolled(g, spectrogram.image, spectrogram.nextColumn, responseAreaSpectr);//spectrogramImage
+
+			g.drawImage(getSpectrBackground(), getLocalBounds().toFloat());
+		}
+
+		drawLoudnessReadout(g);
+
+		g.clipRegionIntersects(getLocalBounds());
+	}
+
+	void drawLoudnessReadout(juce::Graphics& g)
+	{
+		g.setFont(loudnessFontHeight);
+		g.setColour(juce::Colours::orange);
+		g.drawFittedText(loudnessText, getLoudnessReadoutArea(), juce::Justification::centredLeft, 1);
+
+		g.setColour(juce::Colours::lightgrey);
+		g.drawFittedText(levelText, getLoudnessReadoutArea().translated(0, -(loudnessFontHeight + 2)), juce::Justification::centredLeft, 1);
+	}
+
+	//slots of readoutValues, the per-channel RMS and peak pairs follow numLoudnessValues
+	enum ReadoutValue
+	{
+		momentaryValue,
+		shortTermValue,
+		integratedValue,
+		rangeValue,
+		truePeakValue,
+		pausedValue,
+		numLoudnessValues
+	};
+
+	//readouts show one decimal, so values are kept in tenths and everything at or below minLoudness is -inf
+	static int toTenths(float db)
+	{
+		return db <= LoudnessMeter::minLoudness ? std::numeric_limits<int>::min() : juce::roundToInt(db * 10.0f);
+	}
+
+	static juce::String tenthsToText(int tenths)
+	{
+		return tenths == std::numeric_limits<int>::min() ? juce::String("-inf") : juce::String(tenths / 10.0, 1);
+	}
+
+	//true if any readout would show a different digit than last frame
+	bool updateReadoutValues()
+	{
+		auto& levels = audioPrc.levelMeter;
+		const auto numChannels = levels.getNumChannels();
+		const auto numValues = (size_t)(numLoudnessValues + 2 * numChannels);
+
+		bool changed = readoutValues.size() != numValues;
+		readoutValues.resize(numValues);
+
+		auto update = [&](int index, int value)
+		{
+			auto& last = readoutValues[(size_t)index];
+			changed = changed || value != last;
+			last = value;
+		};
+
+		auto gainToTenths = [](float gain) { return toTenths(juce::Decibels::gainToDecibels(gain, LoudnessMeter::minLoudness)); };
+
+		update(momentaryValue, toTenths(audioPrc.loudnessMeter.getMomentaryLoudness()));
+		update(shortTermValue, toTenths(audioPrc.loudnessMeter.getShortTermLoudness()));
+		update(integratedValue, toTenths(audioPrc.loudnessIntegrator.getIntegratedLoudness()));
+		update(rangeValue, juce::roundToInt(audioPrc.loudnessIntegrator.getLoudnessRange() * 10.0f));
+		update(truePeakValue, gainToTenths(audioPrc.truePeakMeter.getMaxHold()));
+		update(pausedValue, audioPrc.loudnessIntegrator.isPaused() ? 1 : 0);
+
+		for (int ch = 0; ch < numChannels; ++ch)
+		{
+			update(numLoudnessValues + 2 * ch, gainToTenths(levels.getRMS(ch)));
+			update(numLoudnessValues + 2 * ch + 1, gainToTenths(levels.getPeak(ch)));
+		}
+
+		return changed;
+	}
+
+	juce::String getLoudnessReadoutText() const
+	{
+		juce::String str;
+		str << "M " << tenthsToText(readoutValues[momentaryValue]) << " LUFS   "
+			<< "S " << tenthsToText(readoutValues[shortTermValue]) << " LUFS   "
+			<< "I " << tenthsToText(readoutValues[integratedValue]) << " LUFS   "
+			<< "LRA " << juce::String(readoutValues[rangeValue] / 10.0, 1) << " LU   "
+			<< "TP " << tenthsToText(readoutValues[truePeakValue]) << " dBTP";
+
+		if (readoutValues[pausedValue] != 0)
+			str << "   (paused)";
+
+		return str;
+	}
+
+	juce::String getLevelReadoutText() const
+	{
+		juce::String rmsStr, peakStr;
+		for (size_t i = numLoudnessValues; i + 1 < readoutValues.size(); i += 2)
+		{
+			auto separator = i > numLoudnessValues ? " / " : "";
+			rmsStr << separator << tenthsToText(readoutValues[i]);
+			peakStr << separator << tenthsToText(readoutValues[i + 1]);
+		}
+
+		juce::String str;
+		str << "RMS " << rmsStr << " dBFS   Peak " << peakStr << " dBFS";
+
+		return str;
+	}
+
+	//one group of PPM I / PPM II / VU bars per channel on a -60..0 dBFS scale
+	void drawBallistics(juce::Graphics& g, juce::Rectangle<int> area)
+	{
+		auto& meter = audioPrc.ballisticsMeter;
+		const int numChannels = meter.getNumChannels();
+
+		if (numChannels == 0 || area.isEmpty())
+			return;
+
+		constexpr float minDb = -60.0f;
+		constexpr int labelHeight = 14;
+
+		auto scaleArea = area.removeFromLeft(30);
+		area.removeFromBottom(labelHeight);
+		scaleArea.removeFromBottom(labelHeight);
+
+		auto dbToY = [&](float db)
+		{
+			return juce::jmap(juce::jlimit(minDb, 0.0f, db), minDb, 0.0f, (float)area.getBottom(), (float)area.getY());
+		};
+
+		g.setFont(10.0f);
+		for (float db = 0.0f; db >= minDb; db -= 6.0f)
+		{
+			const auto y = dbToY(db);
+
+			g.setColour(juce::Colours::dimgrey);
+			g.drawHorizontalLine(juce::roundToInt(y), (float)area.getX(), (float)area.getRight());
 
-			for each(auto background in myBackgroundsSpectr)
+			g.setColour(juce::Colours::lightgrey);
+			g.drawText(juce::String((int)db), scaleArea.getX(), juce::roundToInt(y) - 5, scaleArea.getWidth() - 4, 10, juce::Justification::centredRight);
+		}
+
+		const juce::Colour scaleColours[BallisticsMeter::numScales]{ juce::Colours::skyblue, juce::Colours::white, juce::Colours::orange };
+		const int groupWidth = area.getWidth() / numChannels;
+		const int barWidth = juce::jmax(1, groupWidth / (BallisticsMeter::numScales + 1));
+
+		for (int ch = 0; ch < numChannels; ++ch)
+		{
+			auto group = area.withX(area.getX() + ch * groupWidth).withWidth(groupWidth).reduced(barWidth / 2, 0);
+
+			for (int scale = 0; scale < BallisticsMeter::numScales; ++scale)
 			{
-				if (spectrGridChoice == background.first)
-				{
-					g.drawImage(background.second, getLocalBounds().toFloat());
-				}
+				auto bar = group.removeFromLeft(barWidth);
+				const auto db = juce::Decibels::gainToDecibels(meter.getLevel(static_cast<BallisticsMeter::Scale>(scale), ch), minDb);
+
+				g.setColour(scaleColours[scale]);
+				g.fillRect(juce::Rectangle<float>((float)bar.getX() + 1.0f, dbToY(db), (float)bar.getWidth() - 2.0f, (float)bar.getBottom() - dbToY(db)));
+
+				g.setColour(juce::Colours::lightgrey);
+				g.drawFittedText(BallisticsMeter::getScaleName(static_cast<BallisticsMeter::Scale>(scale)), bar.getX(), bar.getBottom(), bar.getWidth(), labelHeight, juce::Justification::centred, 1);
 			}
 		}
+	}
 
-		g.clipRegionIntersects(getLocalBounds());
+	juce::Rectangle<int> getLoudnessReadoutArea()
+	{
+		return getLocalBounds().removeFromBottom(loudnessFontHeight + 6).withTrimmedLeft(25);
+	}
+
+	//both readout lines
+	juce::Rectangle<int> getReadoutsArea()
+	{
+		auto area = getLoudnessReadoutArea();
+		return area.withTop(area.getY() - (loudnessFontHeight + 2));
+	}
+
+	//the analysis area and its rounded outline
+	juce::Rectangle<int> getDirtyAreaRMS()
+	{
+		return getAnalysisAreaRMS().expanded(1);
+	}
+
+	//clicking the readout starts a new integrated / LRA measurement
+	void mouseDown(const juce::MouseEvent& e) override
+	{
+		if (getLoudnessReadoutArea().contains(e.getPosition()))
+			audioPrc.resetLoudnessIntegration();
 	}
 
 	void resized() override
 	{	
-		//RMS area spaces 
-		auto renderAreaRMS = getAnalysisAreaRMS();
-		auto leftRMS = renderAreaRMS.getX();
-		auto rightRMS = renderAreaRMS.getRight();
-		auto topRMS = renderAreaRMS.getY();
-		auto bottomRMS = renderAreaRMS.getHeight();
-		auto widthRMS = renderAreaRMS.getWidth();
-		
-		//Line Colour
-		//auto myColour = juce::Colour(255u, 41u, 41u);//Red
-		juce::Array<juce::Colour> myColour = 
+		analysisWorker.setRMSBounds(getAnalysisAreaRMS());
+
+		//the backgrounds are rebuilt lazily once the resize has settled
+		lastResizeTime = juce::Time::getMillisecondCounter();
+		backgroundsPending = true;
+	}
+
+	/**
+	 One grid background, rendered for a single (size, genre, colour) and reused
+	 until one of them changes.
+	 */
+	struct CachedBackground
+	{
+		bool matches(juce::Rectangle<int> newSize, int newGenre, juce::Colour newColour) const
+		{
+			return image.isValid() && size == newSize && genre == newGenre && colour == newColour;
+		}
+
+		juce::Image image;
+		juce::Rectangle<int> size;
+		int genre = -1;
+		juce::Colour colour;
+	};
+
+	static juce::Colour getGenreColour(int genre)
+	{
+		const juce::Colour myColour[] =
 		{
 			juce::Colour(255u, 41u, 41u), juce::Colour(79u, 252u, 45u), juce::Colour(45u, 121u,252u),
 			juce::Colour(231u, 45u, 252u), juce::Colour(252u, 45u, 45u), juce::Colour(252u, 252u, 45u)
 		};
 
-		juce::Array<float> myFreqRMSArray[] =
+		return myColour[juce::jlimit(0, juce::numElementsInArray(myColour) - 1, genre)];
+	}
+
+	//frequencies drawn by each genre's grid, and the one that is highlighted
+	static const juce::Array<float>& getGenreFrequencies(int genre)
+	{
+		static const juce::Array<float> myFreqArray[] =
 		{
 			{ 20.f, 50.f, 100.f, 200.f, 500.f, 1000.f, 2000.f, 5000.f, 10000.f, 20000.f },
 			{ 20.f, 60.f, 300.f, 400.f, 600.f, 2000.f, 3000.f, 6000.f, 9000.f, 20000.f },
@@ -458,69 +736,71 @@ public:
 			{ 20.f, 200.f, 2000.f, 20000.f }
 		};
 
+		return myFreqArray[juce::jlimit(0, juce::numElementsInArray(myFreqArray) - 1, genre)];
+	}
+
+	static float getGenreColouredFrequency(int genre)
+	{
+		const float dbToBeColored[] = { 500.f, 9000.f, 20000.f, 5000.f, 1000.f, 2000.f };
+
+		return dbToBeColored[juce::jlimit(0, juce::numElementsInArray(dbToBeColored) - 1, genre)];
+	}
+
+	//while the window is being dragged the stale background is stretched instead
+	bool isResizing() const
+	{
+		return juce::Time::getMillisecondCounter() - lastResizeTime < resizeSettleMs;
+	}
+
+	const juce::Image& getRMSBackground()
+	{
+		const auto colour = getGenreColour(rmsGridChoice);
+
+		if (rmsBackground.matches(getLocalBounds(), rmsGridChoice, colour) || (rmsBackground.image.isValid() && isResizing()))
+			return rmsBackground.image;
+
+		//RMS area spaces 
+		auto renderAreaRMS = getAnalysisAreaRMS();
+
 		//Gain Array
 		juce::Array<float> gain
 		{
 			-24.f, -12.f, 0.f, 12.f, 24.f
 		};
 
-		myBackgroundsRMS =
-		{
-			{0, juce::Image(juce::Image::PixelFormat::RGB, getWidth(), getHeight(), true)},
-			{1, juce::Image(juce::Image::PixelFormat::RGB, getWidth(), getHeight(), true)},
-			{2, juce::Image(juce::Image::PixelFormat::RGB, getWidth(), getHeight(), true)},
-			{3, juce::Image(juce::Image::PixelFormat::RGB, getWidth(), getHeight(), true)},
-			{4, juce::Image(juce::Image::PixelFormat::RGB, getWidth(), getHeight(), true)},
-			{5, juce::Image(juce::Image::PixelFormat::RGB, getWidth(), getHeight(), true)}
-		};
+		rmsBackground.image = juce::Image(juce::Image::PixelFormat::RGB, getWidth(), getHeight(), true);
+		rmsBackground.size = getLocalBounds();
+		rmsBackground.genre = rmsGridChoice;
+		rmsBackground.colour = colour;
 
-		juce::Array<float> dbToBeColoredRMS =
-		{
-			500.f, 9000.f, 20000.f, 5000.f, 1000.f, 2000.f
-		};
+		RMSGrid(getGenreFrequencies(rmsGridChoice), gain, rmsBackground.image, renderAreaRMS, renderAreaRMS.getX(), renderAreaRMS.getRight(),
+				renderAreaRMS.getY(), renderAreaRMS.getHeight(), renderAreaRMS.getWidth(), colour, getGenreColouredFrequency(rmsGridChoice));
 
-		for each (auto background in myBackgroundsRMS)
-			RMSGrid(myFreqRMSArray[background.first], gain, background.second, renderAreaRMS, leftRMS, rightRMS, topRMS, bottomRMS, widthRMS, myColour[background.first], dbToBeColoredRMS[background.first]);
+		return rmsBackground.image;
+	}
+
+	const juce::Image& getSpectrBackground()
+	{
+		const auto colour = getGenreColour(spectrGridChoice);
+
+		if (spectrBackground.matches(getLocalBounds(), spectrGridChoice, colour) || (spectrBackground.image.isValid() && isResizing()))
+			return spectrBackground.image;
 
 		//Spectr area spaces 
 		auto renderAreaSpectr = getAnalysisAreaSpectr();
-		auto leftSpectr = renderAreaSpectr.getX();
-		auto rightSpectr = renderAreaSpectr.getRight();
-		auto topSpectr = renderAreaSpectr.getY();
-		auto bottomSpectr = renderAreaSpectr.getHeight();
-		auto widthSpectr = renderAreaSpectr.getWidth();
-
-		//Frequencies Array Spectr
-		juce::Array<float> myFreqSpectrArray[] =  
-		{
-			{ 20.f, 50.f, 100.f, 200.f, 500.f, 1000.f, 2000.f, 5000.f, 10000.f, 20000.f },
-			{ 20.f, 60.f, 300.f, 400.f, 600.f, 2000.f, 3000.f, 6000.f, 9000.f, 20000.f },
-			{ 20.f, 20000.f },
-			{ 20.f, 50.f, 500.f, 5000.f, 20000.f },
-			{ 20.f, 100.f, 1000.f, 10000.f, 20000.f },
-			{ 20.f, 200.f, 2000.f, 20000.f }
-		};
 
-		myBackgroundsSpectr =
-		{
-			{0, juce::Image(juce::Image::PixelFormat::ARGB, getWidth(), getHeight(), true)},
-			{1, juce::Image(juce::Image::PixelFormat::ARGB, getWidth(), getHeight(), true)},
-			{2, juce::Image(juce::Image::PixelFormat::ARGB, getWidth(), getHeight(), true)},
-			{3, juce::Image(juce::Image::PixelFormat::ARGB, getWidth(), getHeight(), true)},
-			{4, juce::Image(juce::Image::PixelFormat::ARGB, getWidth(), getHeight(), true)},
-			{5, juce::Image(juce::Image::PixelFormat::ARGB, getWidth(), getHeight(), true)}
-		};
+		spectrBackground.image = juce::Image(juce::Image::PixelFormat::ARGB, getWidth(), getHeight(), true);
+		spectrBackground.size = getLocalBounds();
+		spectrBackground.genre = spectrGridChoice;
+		spectrBackground.colour = colour;
 
-		juce::Array<float> dbToBeColoredSpectr = 
-		{
-			500.f, 9000.f, 20000.f, 5000.f, 1000.f, 2000.f
-		};
+		spectrGrid(getGenreFrequencies(spectrGridChoice), spectrBackground.image, renderAreaSpectr, renderAreaSpectr.getX(), renderAreaSpectr.getRight(),
+				   renderAreaSpectr.getY(), renderAreaSpectr.getHeight(), renderAreaSpectr.getWidth(), colour, getGenreColouredFrequency(spectrGridChoice));
 
-		for each(auto background in myBackgroundsSpectr)
-			spectrGrid(myFreqSpectrArray[background.first], background.second, renderAreaSpectr, leftSpectr, rightSpectr, topSpectr, bottomSpectr, widthSpectr, myColour[background.first], dbToBeColoredSpectr[background.first]);
+		return spectrBackground.image;
 	}
 
-	void RMSGrid(juce::Array<float> freqRMS, juce::Array<float> gain, juce::Image imageRMS, juce::Rectangle<int> renderAreaRMS, int leftRMS, int rightRMS, int topRMS, int bottomRMS, int widthRMS, juce::Colour myColour, float numToBeColored)
+	void RMSGrid(const juce::Array<float>& freqRMS, const juce::Array<float>& gain, juce::Image imageRMS, juce::Rectangle<int> renderAreaRMS, int leftRMS, int rightRMS, int topRMS, int bottomRMS, int widthRMS, juce::Colour myColour, float numToBeColored)
 	{
 		juce::Graphics gRMS(imageRMS);
 
@@ -612,7 +892,7 @@ public:
 		}
 	}
 
-	void spectrGrid(juce::Array<float> freqSpectr, juce::Image spectrImage, juce::Rectangle<int> renderAreaSpectr, int leftSpectr, int rightSpectr, int topSpectr, int bottomSpectr, int widthSpectr, juce::Colour myColour, float numToBeColored)
+	void spectrGrid(const juce::Array<float>& freqSpectr, juce::Image spectrImage, juce::Rectangle<int> renderAreaSpectr, int leftSpectr, int rightSpectr, int topSpectr, int bottomSpectr, int widthSpectr, juce::Colour myColour, float numToBeColored)
 	{
 		juce::Graphics gSpectr(spectrImage);
 
@@ -669,25 +949,98 @@ public:
 
 	void timerCallback() override
 	{
-		auto fftBounds = getAnalysisAreaRMS().toFloat();
-		auto sampleRate = audioPrc.getSampleRate();
+		refreshDisplay();
+	}
+
+	/**
+	 Once per display frame: takes over whatever the analysis produced and
+	 invalidates only the parts of the component that actually changed.
+	 */
+	void refreshDisplay()
+	{
+		//picks up the parameters once per frame, the audio thread never touches this component
+		auto snapshot = audioPrc.getParameterSnapshot();
+		if (snapshot != lastSnapshot)
+		{
+			applyParameterSnapshot(snapshot);
+			repaint();
+		}
 
-		leftPathProducer.process(fftBounds, sampleRate);
-		rightPathProducer.process(fftBounds, sampleRate);
+		//the resize has settled, redraw once with freshly rendered backgrounds
+		if (backgroundsPending && !isResizing())
+		{
+			backgroundsPending = false;
+			repaint();
+		}
 
-		spectrImageProducer.process(sampleRate);
+		//the analysis runs on its own thread, here only the newest results are taken over
+		const bool newPaths = analysisWorker.pullLatestPaths();
+		const bool newColumns = analysisWorker.pullLatestSpectrogram();
 
-		repaint();
+		if (isBallistics)
+		{
+			if (updateBallisticsLevels())
+				repaint(getAnalysisAreaRMS().reduced(10, 20));
+		}
+		else if (isRMS)
+		{
+			if (newPaths)
+				repaint(getDirtyAreaRMS());
+		}
+		else if (newColumns)
+		{
+			repaint(getAnalysisAreaSpectr());
+		}
 
-		if (audioPrc.nextFFTBlockReady)
+		//the strings are only rebuilt when a displayed digit changes
+		if (updateReadoutValues())
 		{
-			drawNextLineOfSpectrogram();
-			audioPrc.nextFFTBlockReady = false;
-			repaint();
+			loudnessText = getLoudnessReadoutText();
+			levelText = getLevelReadoutText();
+			repaint(getReadoutsArea());
 		}
 	}
 
-	void selGrid(const int choice)
+	//true if any needle moved since the last frame
+	bool updateBallisticsLevels()
+	{
+		auto& meter = audioPrc.ballisticsMeter;
+		const auto numLevels = (size_t)(meter.getNumChannels() * BallisticsMeter::numScales);
+
+		bool changed = lastBallisticsLevels.size() != numLevels;
+		lastBallisticsLevels.resize(numLevels);
+
+		for (int ch = 0; ch < meter.getNumChannels(); ++ch)
+		{
+			for (int scale = 0; scale < BallisticsMeter::numScales; ++scale)
+			{
+				const auto level = meter.getLevel(static_cast<BallisticsMeter::Scale>(scale), ch);
+				auto& last = lastBallisticsLevels[(size_t)(ch * BallisticsMeter::numScales + scale)];
+
+				changed = changed || level != last;
+				last = level;
+			}
+		}
+
+		return changed;
+	}
+
+	void applyParameterSnapshot(const ParameterSnapshot& snapshot)
+	{
+		selGrid(snapshot.graftType, snapshot.meterView);
+		changeRMSOffset(snapshot.rmsLineOffset);
+		pathOrderChoice(snapshot.orderSwitch);
+		switchSpectrParams(snapshot.lvlKnobSpectr, snapshot.skPropSpectr, snapshot.lvlOffSpectr);
+		switchSpectrogram(snapshot.genreSpectr);
+		switchRMS(snapshot.genreRMS);
+
+		analysisWorker.setSpectrogramParameters(lvlKnobSpectr, skPropSpectr, lvlOffSpectr);
+
+		lastSnapshot = snapshot;
+	}
+
+	//the PPM / VU meter view covers whichever analyzer GRAFTYPE selects
+	void selGrid(const int choice, const int meterView)
 	{
 		switch (choice)
 		{
@@ -701,6 +1054,11 @@ public:
 			jassertfalse;
 			break;
 		}
+
+		isBallistics = meterView == 1;
+
+		analysisWorker.setView(isBallistics ? AnalysisWorker::ballisticsView
+							  : isRMS ? AnalysisWorker::rmsView : AnalysisWorker::spectrogramView);
 	}
 
 	juce::Rectangle<int> getRenderAreaRMS()
@@ -748,40 +1106,14 @@ public:
 		return area;
 	}
 
-	void drawNextLineOfSpectrogram()
-	{
-		const int rightHandEdge = spectrogramImage.getWidth() - 1;
-		const int imageHeight = spectrogramImage.getHeight();
-
-		spectrogramImage.moveImageSection(0, 0, 1, 0, rightHandEdge, imageHeight);
-
-		forwardFFT.performFrequencyOnlyForwardTransform(audioPrc.fftData);
-
-		juce::Range<float> maxLevel = juce::FloatVectorOperations::findMinAndMax(audioPrc.fftData, audioPrc.fftSize / 2);
-
-		if (maxLevel.getEnd() == 0.0f)
-			maxLevel.setEnd(lvlKnobSpectr);//0.00001f
-
-		for (int i = 1; i < imageHeight; ++i)
-		{
-			const float skewedProportionY = 1.0f - std::exp(std::log(i / (float)imageHeight) * skPropSpectr);//0.2f
-			const int fftDataIndex = juce::jlimit(0, audioPrc.fftSize / 2, (int)(skewedProportionY * audioPrc.fftSize / 2));
-			const float level = juce::jmap(audioPrc.fftData[fftDataIndex], 0.0f, maxLevel.getEnd(), 0.0f, lvlOffSpectr);//Original targetRangeMax = 3.9f, needs to be tweaked/tested
-
-			spectrogramImage.setPixelAt(rightHandEdge, i, juce::Colour::fromHSL(level, 1.0f, level, 1.0f));//Colour::fromHSV
-		}
-	}
-
 	void changeRMSOffset(const float myRMSOffset)
 	{
-		leftPathProducer.offsetRMS = myRMSOffset;
-		rightPathProducer.offsetRMS = myRMSOffset;
+		analysisWorker.setRMSOffset(myRMSOffset);
 	}
 
 	void pathOrderChoice(const int choice)
 	{
-		leftPathProducer.orderChoice = choice;
-		rightPathProducer.orderChoice = choice;
+		analysisWorker.setOrderChoice(choice);
 	}
 
 	void switchSpectrParams(float lvlKnobSpectrVar, float skrPropSpectrVar, float lvlOffSpectrVar)
@@ -868,24 +1200,38 @@ public:
 private:
 	Loudness_MeterAudioProcessor& audioPrc;
 
-	juce::dsp::FFT forwardFFT;
-	juce::Image spectrogramImage;
+	//only the selected genre of each view is ever rendered
+	CachedBackground rmsBackground, spectrBackground;
+	bool backgroundsPending = false;
+	juce::uint32 lastResizeTime = 0;
+	static constexpr juce::uint32 resizeSettleMs = 150;
 
-	std::map<int, juce::Image> myBackgroundsSpectr;
-	std::map<int, juce::Image> myBackgroundsRMS;
+	//channel 0 keeps the skyblue and channel 1 the white of the original stereo view
+	const juce::Colour channelColours[6]{ juce::Colours::skyblue, juce::Colours::white, juce::Colours::orange,
+										  juce::Colours::limegreen, juce::Colours::violet, juce::Colours::gold };
 
-	PathProducer leftPathProducer, rightPathProducer;
+	AnalysisWorker analysisWorker;
 
-	ImageProducer spectrImageProducer;
+	ParameterSnapshot lastSnapshot;
+
+	static constexpr int loudnessFontHeight = 12;
 
 	bool isRMS = false;
+	bool isBallistics = false;
 	int spectrGridChoice = 0;	
 	int rmsGridChoice = 0;
 	float lvlKnobSpectr = 0.00001f;
 	float skPropSpectr = 0.2f;
 	float lvlOffSpectr = 3.9f;
 
-	float maxValue = 1;
+	std::vector<int> readoutValues;
+	juce::String loudnessText, levelText;
+	std::vector<float> lastBallisticsLevels;
+
+#if JUCE_MAJOR_VERSION >= 7
+	//repaints in step with the display, see refreshDisplay()
+	juce::VBlankAttachment vBlankAttachment{ this, [this] { refreshDisplay(); } };
+#endif
 };
 
 //==============================================================================
@@ -1000,11 +1346,11 @@ private:
 	KnobManager mydBKnobs;
 	
 	//Spectr selector and attachment	
-	static constexpr auto numSelectors = 5;
+	static constexpr auto numSelectors = 9;
 
 	juce::String mySelectorNames[numSelectors]
 	{
-		"GRAFTYPE", "ORDERSWITCH", "COLOURGRIDSWITCH", "GENRE", "GENRERMS"
+		"GRAFTYPE", "ORDERSWITCH", "COLOURGRIDSWITCH", "GENRE", "GENRERMS", "STFTOVERLAP", "STFTWINDOW", "LEVELWINDOW", "METERVIEW"
 	};
 
 	using ComboBoxAttachment = juce::AudioProcessorValueTreeState::ComboBoxAttachment;
@@ -1051,7 +1397,9 @@ private:
 		juce::StringArray choices[numSelectors]
 		{
 			{ "RMS", "Spectrogram" }, { "Order 2048", "Order 4096", "Order 8192" }, { "Green", "Red", "Blue" },
-			{ "Spectrogram", "Techno", "House", "IDM", "EDM", "Downtempo" }, { "RMS", "Techno", "House", "IDM", "EDM", "Downtempo" }
+			{ "Spectrogram", "Techno", "House", "IDM", "EDM", "Downtempo" }, { "RMS", "Techno", "House", "IDM", "EDM", "Downtempo" },
+			{ "Overlap 50%", "Overlap 75%", "Overlap 87.5%" }, { "Hann", "Hamming", "Blackman-Harris" },
+			{ "Level 300 ms", "Level 3 s" }, { "Analyzer", "PPM / VU" }
 		};
 	};
 
@@ -19,10 +19,28 @@ Loudness_MeterAudioProcessor::Loudness_MeterAudioProcessor()
                       #endif
                        .withOutput ("Output", juce::AudioChannelSet::stereo(), true)
                      #endif
-                       ), apvts(*this, nullptr, "Parameters", createParams()), fFft(fftSize), 
-						  fWindow(fFft.getSize() + 1, juce::dsp::WindowingFunction<float>::hann, false)
+                       ), apvts(*this, nullptr, "Parameters", createParams())
 #endif
 {
+	graftTypeParam = apvts.getRawParameterValue("GRAFTYPE");
+	meterViewParam = apvts.getRawParameterValue("METERVIEW");
+	orderSwitchParam = apvts.getRawParameterValue("ORDERSWITCH");
+	colourGridSwitchParam = apvts.getRawParameterValue("COLOURGRIDSWITCH");
+	genreSpectrParam = apvts.getRawParameterValue("GENRE");
+	genreRMSParam = apvts.getRawParameterValue("GENRERMS");
+	rmsLineOffsetParam = apvts.getRawParameterValue("RMSLINEOFFSET");
+	lvlKnobSpectrParam = apvts.getRawParameterValue("LVLKNOBSPECTR");
+	skPropSpectrParam = apvts.getRawParameterValue("SKEWEDPROPYSPECTR");
+	lvlOffSpectrParam = apvts.getRawParameterValue("LVLOFFSETSPECTR");
+	stftOverlapParam = apvts.getRawParameterValue("STFTOVERLAP");
+	stftWindowParam = apvts.getRawParameterValue("STFTWINDOW");
+	levelWindowParam = apvts.getRawParameterValue("LEVELWINDOW");
+
+	loudnessMeter.setListener(&loudnessIntegrator);
+
+	//the rings get their storage once the layout is known and somebody reads them
+	for (int ch = 0; ch < maxAnalysisChannels; ++ch)
+		channelFifos.add(new SingleChannelSampleFifo<BlockType>(ch));
 }
 
 Loudness_MeterAudioProcessor::~Loudness_MeterAudioProcessor()
@@ -94,16 +112,129 @@ void Loudness_MeterAudioProcessor::changeProgramName (int index, const juce::Str
 //==============================================================================
 void Loudness_MeterAudioProcessor::prepareToPlay (double sampleRate, int samplesPerBlock)
 {
-	leftChannelFifo.prepare(samplesPerBlock);
-	rightChannelFifo.prepare(samplesPerBlock);
+	auto numChannels = juce::jmin(getTotalNumInputChannels(), maxAnalysisChannels);
 
-	spectrChannelFifo.prepare(samplesPerBlock);
+	loudnessMeter.prepare(sampleRate, numChannels);
+	truePeakMeter.prepare(numChannels, samplesPerBlock);
+	levelMeter.prepare(sampleRate, numChannels);
+	ballisticsMeter.prepare(sampleRate, numChannels);
+	silenceDetector.prepare(sampleRate);
+
+	if (getBusCount(true) > 0)
+	{
+		auto layout = getChannelLayoutOfBus(true, 0);
+		for (int ch = 0; ch < numChannels; ++ch)
+			loudnessMeter.setChannelWeight(ch, LoudnessMeter::getChannelWeight(layout.getTypeOfChannel(ch)));
+	}
+
+	//the readers wait on the lock, so the rings can be resized and reset here
+	const juce::ScopedLock sl(analysisConsumerLock);
+
+	analysisFifoSize = getAnalysisFifoSize(sampleRate);
+	numAnalysisChannels.store(numChannels);
+	analysisPrepared = true;
+
+	//rings only for the channels the bus actually has, and only while the RMS feed is read
+	const bool ringsNeeded = (analysisConsumers.load() & rmsFeed) != 0;
+
+	for (auto* channelFifo : channelFifos)
+	{
+		if (!ringsNeeded || channelFifo->getChannel() >= numChannels)
+			channelFifo->release();
+	}
+
+	if (ringsNeeded)
+		prepareAnalysisRings();
+
+	stftEngine.stop();
+	stftEngine.prepare(sampleRate, analysisFifoSize);
+	updateSTFTEngine();
 }
 
 void Loudness_MeterAudioProcessor::releaseResources()
 {
     // When playback stops, you can use this as an opportunity to free up any
     // spare memory, etc.
+	const juce::ScopedLock sl(analysisConsumerLock);
+
+	analysisPrepared = false;
+	stftEngine.stop();
+
+	for (auto* channelFifo : channelFifos)
+		channelFifo->release();
+}
+
+void Loudness_MeterAudioProcessor::addAnalysisConsumer(int feeds)
+{
+	const juce::ScopedLock sl(analysisConsumerLock);
+
+	for (int feed = 0; feed < numAnalysisFeeds; ++feed)
+	{
+		if ((feeds & (1 << feed)) == 0 || numFeedConsumers[feed]++ > 0)
+			continue;
+
+		//the audio thread starts writing as soon as it sees the bit, so the rings come first
+		if ((1 << feed) == rmsFeed)
+			prepareAnalysisRings();
+
+		analysisConsumers.fetch_or(1 << feed);
+	}
+
+	updateSTFTEngine();
+}
+
+void Loudness_MeterAudioProcessor::removeAnalysisConsumer(int feeds)
+{
+	const juce::ScopedLock sl(analysisConsumerLock);
+
+	for (int feed = 0; feed < numAnalysisFeeds; ++feed)
+	{
+		if ((feeds & (1 << feed)) == 0)
+			continue;
+
+		//removing a feed that was never added would steal another reader's count
+		jassert(numFeedConsumers[feed] > 0);
+
+		if (numFeedConsumers[feed] > 0 && --numFeedConsumers[feed] == 0)
+			analysisConsumers.fetch_and(~(1 << feed));
+	}
+
+	updateSTFTEngine();
+}
+
+//Called with analysisConsumerLock held, while the audio thread does not write the rings.
+//A ring keeps its storage once the RMS feed loses its last reader, because the audio
+//thread may still be inside a block that saw the bit; prepareToPlay and
+//releaseResources free it.
+void Loudness_MeterAudioProcessor::prepareAnalysisRings()
+{
+	if (!analysisPrepared)
+		return;
+
+	for (int ch = 0; ch < numAnalysisChannels.load(); ++ch)
+	{
+		auto* channelFifo = channelFifos.getUnchecked(ch);
+
+		if (channelFifo->getSize() != analysisFifoSize)
+			channelFifo->allocate(analysisFifoSize);
+
+		channelFifo->prepare();
+	}
+}
+
+//called with analysisConsumerLock held, the thread only runs between prepareToPlay and
+//releaseResources and only while somebody reads its columns
+void Loudness_MeterAudioProcessor::updateSTFTEngine()
+{
+	const bool shouldRun = analysisPrepared && (analysisConsumers.load() & stftFeed) != 0;
+
+	if (shouldRun == stftEngine.isRunning())
+		return;
+
+	if (shouldRun)
+		stftEngine.start();
+	else
+		stftEngine.stop();
 }
 
 #ifndef JucePlugin_PreferredChannelConfigurations
@@ -113,12 +244,9 @@ bool Loudness_MeterAudioProcessor::isBusesLayoutSupported (const BusesLayout& la
     juce::ignoreUnused (layouts);
     return true;
   #else
-    // This is the place where you check if the layout is supported.
-    // In this template code we only support mono or stereo.
-    // Some plugin hosts, such as certain GarageBand versions, will only
-    // load plugins that support stereo bus layouts.
-    if (layouts.getMainOutputChannelSet() != juce::AudioChannelSet::mono()
-     && layouts.getMainOutputChannelSet() != juce::AudioChannelSet::stereo())
+    // Mono up to 7.1.4, every meter and analyzer is sized for twelve channels.
+    auto numChannels = layouts.getMainOutputChannelSet().size();
+    if (numChannels < 1 || numChannels > maxAnalysisChannels)
         return false;
 
     // This checks if the input layout matches the output layout
@@ -142,86 +270,228 @@ void Loudness_MeterAudioProcessor::processBlock (juce::AudioBuffer<float>& buffe
     for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
         buffer.clear (i, 0, buffer.getNumSamples());
 
-	leftChannelFifo.update(buffer);
-	rightChannelFifo.update(buffer);
+	updateLoudnessTransport();
+	loudnessMeter.process(buffer);
+	truePeakMeter.process(buffer);
+
+	levelMeter.setIntegrationWindow(static_cast<LevelMeter::IntegrationWindow>(static_cast<int>(levelWindowParam->load())));
+	levelMeter.process(buffer);
+	ballisticsMeter.process(buffer);
 
-	spectrChannelFifo.update(buffer);
+	//with no reader attached (editor closed) nothing beyond the metering above runs
+	const auto consumers = analysisConsumers.load(std::memory_order_relaxed);
+	if (consumers == 0)
+		return;
 
-	//auto hopSize = buffer.getNumSamples() / 2;
+	auto numChannels = juce::jmin(numAnalysisChannels.load(), buffer.getNumChannels());
+
+	//a silent input produces no analysis frames, the meters above keep running
+	if (silenceDetector.process(buffer, numChannels))
+		return;
 
 	if (buffer.getNumChannels() > 0)
 	{
-		const float* channelData = buffer.getReadPointer(0);
-		for (int sample = 0; sample < buffer.getNumSamples(); ++sample)
-			pushNextSampleIntoFifo(channelData[sample]);
+		if ((consumers & rmsFeed) != 0)
+		{
+			for (int ch = 0; ch < numChannels; ++ch)
+				channelFifos.getUnchecked(ch)->update(buffer);
+		}
 
-		STFT(buffer, buffer.getNumSamples() / 2);
+		if ((consumers & stftFeed) != 0)
+		{
+			static constexpr STFTEngine::WindowingMethod stftWindows[] =
+			{
+				STFTEngine::WindowingMethod::hann, STFTEngine::WindowingMethod::hamming, STFTEngine::WindowingMethod::blackmanHarris
+			};
+
+			stftEngine.setOverlap(static_cast<STFTEngine::Overlap>(static_cast<int>(stftOverlapParam->load())));
+			stftEngine.setWindow(stftWindows[static_cast<int>(stftWindowParam->load())]);
+			stftEngine.pushSamples(buffer);
+		}
 	}
+}
 
-	auto &graftOutputType = *apvts.getRawParameterValue("GRAFTYPE");
-	auto &orderSwitch = *apvts.getRawParameterValue("ORDERSWITCH");
-	auto &colourGridSwitch = *apvts.getRawParameterValue("COLOURGRIDSWITCH");
-	auto &rmsLevelOffset = *apvts.getRawParameterValue("RMSLINEOFFSET");
-	auto &genreSelectorSpectr = *apvts.getRawParameterValue("GENRE");	
-	auto &genreSelectorRMS = *apvts.getRawParameterValue("GENRERMS");
-	auto &lvlKnobSpectr = *apvts.getRawParameterValue("LVLKNOBSPECTR");
-	auto &skPropSpectr = *apvts.getRawParameterValue("SKEWEDPROPYSPECTR");	
-	auto &lvlOffSpectr = *apvts.getRawParameterValue("LVLOFFSETSPECTR");
-
-	auto myRepData = dynamic_cast<Loudness_MeterAudioProcessorEditor*>(getActiveEditor());
-	if (myRepData != nullptr)
+void Loudness_MeterAudioProcessor::updateLoudnessTransport()
+{
+	if (loudnessResetRequested.exchange(false))
 	{
-		myRepData->gridRepresentation.selGrid(graftOutputType);
-		myRepData->gridRepresentation.changeRMSOffset(rmsLevelOffset);
-		myRepData->gridRepresentation.pathOrderChoice(orderSwitch);
-		myRepData->gridRepresentation.switchSpectrParams(lvlKnobSpectr, skPropSpectr, lvlOffSpectr);
-		myRepData->gridRepresentation.switchSpectrogram(genreSelectorSpectr);
-		myRepData->gridRepresentation.switchRMS(genreSelectorRMS);
+		loudnessIntegrator.reset();
+		truePeakMeter.reset();
 	}
+
+	auto* playHead = getPlayHead();
+	bool isPlaying = false;
+	juce::int64 timeInSamples = 0;
+
+#if JUCE_MAJOR_VERSION >= 7
+	auto position = playHead != nullptr ? playHead->getPosition() : juce::Optional<juce::AudioPlayHead::PositionInfo>();
+	const bool hasPosition = position.hasValue();
+
+	if (hasPosition)
+	{
+		isPlaying = position->getIsPlaying();
+		timeInSamples = position->getTimeInSamples().orFallback(lastPlayedTimeInSamples);
+	}
+#else
+	juce::AudioPlayHead::CurrentPositionInfo position;
+	const bool hasPosition = playHead != nullptr && playHead->getCurrentPosition(position);
+
+	if (hasPosition)
+	{
+		isPlaying = position.isPlaying;
+		timeInSamples = position.timeInSamples;
+	}
+#endif
+
+	//no transport (standalone, live input), keep measuring
+	if (!hasPosition)
+	{
+		loudnessIntegrator.setPaused(false);
+		return;
+	}
+
+	if (isPlaying && !wasPlaying && timeInSamples < lastPlayedTimeInSamples)
+		loudnessIntegrator.reset();
+
+	if (isPlaying)
+		lastPlayedTimeInSamples = timeInSamples;
+
+	loudnessIntegrator.setPaused(!isPlaying);
+	wasPlaying = isPlaying;
 }
 
-void Loudness_MeterAudioProcessor::pushNextSampleIntoFifo(float sample) noexcept
+ParameterSnapshot Loudness_MeterAudioProcessor::getParameterSnapshot() const
 {
-	if (fifoIndex == fftSize)
+	ParameterSnapshot snapshot;
+
+	snapshot.graftType = static_cast<int>(graftTypeParam->load());
+	snapshot.meterView = static_cast<int>(meterViewParam->load());
+	snapshot.orderSwitch = static_cast<int>(orderSwitchParam->load());
+	snapshot.colourGridSwitch = static_cast<int>(colourGridSwitchParam->load());
+	snapshot.genreSpectr = static_cast<int>(genreSpectrParam->load());
+	snapshot.genreRMS = static_cast<int>(genreRMSParam->load());
+	snapshot.rmsLineOffset = rmsLineOffsetParam->load();
+	snapshot.lvlKnobSpectr = lvlKnobSpectrParam->load();
+	snapshot.skPropSpectr = skPropSpectrParam->load();
+	snapshot.lvlOffSpectr = lvlOffSpectrParam->load();
+
+	return snapshot;
+}
+
+//==============================================================================
+STFTEngine::STFTEngine(int order, Channel ch) : juce::Thread("STFT"), fft(order), input(ch)
+{
+	auto fftSize = (size_t)fft.getSize();
+
+	//one extra point so the first fftSize samples form a periodic window
+	window.resize(fftSize + 1, 0.0f);
+	frame.resize(fftSize, 0.0f);
+	fftBuffer.resize(fftSize * 2, 0.0f);
+	column.resize((size_t)getNumBins(), 0.0f);
+
+	columnFifo.prepare(column.size());
+}
+
+STFTEngine::~STFTEngine()
+{
+	stop();
+}
+
+void STFTEngine::prepare(double newSampleRate, int inputFifoSize)
+{
+	jassert(!isThreadRunning());
+
+	sampleRate = newSampleRate;
+
+	//the STFT thread is the ring's only reader and it is stopped here
+	if (input.getSize() != inputFifoSize)
+		input.allocate(inputFifoSize);
+	input.prepare();
+
+	std::fill(frame.begin(), frame.end(), 0.0f);
+	currentOverlap = -1;
+	currentWindow = -1;
+	updateConfiguration();
+}
+
+void STFTEngine::start()
+{
+	//samples left from before the last stop would show up as a stale column
+	input.discardSamples(input.getNumSamplesAvailable());
+	std::fill(frame.begin(), frame.end(), 0.0f);
+
+	startThread();
+}
+
+void STFTEngine::stop()
+{
+	stopThread(1000);
+}
+
+void STFTEngine::run()
+{
+	while (!threadShouldExit())
 	{
-		if (!nextFFTBlockReady)
+		updateConfiguration();
+
+		if (input.checkAndClearOverflow())
+			input.discardOldest(0);
+
+		const auto fftSize = fft.getSize();
+
+		while (input.getNumSamplesAvailable() >= hopSize && !threadShouldExit())
 		{
-			juce::zeromem(fftData, sizeof(fftData));
-			memcpy(fftData, fifo, sizeof(fifo));
-			nextFFTBlockReady = true;
+			std::copy(frame.begin() + hopSize, frame.end(), frame.begin());
+			input.pullSamples(frame.data() + fftSize - hopSize, hopSize);
+
+			computeColumn();
 		}
-		fifoIndex = 0;
+
+		wait(pollIntervalMs);
 	}
-	fifo[fifoIndex++] = sample;
 }
 
-void Loudness_MeterAudioProcessor::STFT(const juce::AudioSampleBuffer & signal, size_t hop)
+void STFTEngine::updateConfiguration()
 {
-	//using Spectrum = std::vector<float>;
+	const auto fftSize = fft.getSize();
 
-	//const float * data = signal.getReadPointer(0);
-	//const size_t dataCount = signal.getNumSamples();
+	auto method = requestedWindow.load();
+	if (method != currentWindow)
+	{
+		juce::dsp::WindowingFunction<float>::fillWindowingTables(window.data(), window.size(), (WindowingMethod)method, false);
 
-	//ptrdiff_t fftSize = fFft.getSize();
+		//the window's coherent gain, and the factor of two for the one-sided spectrum,
+		//so levels do not move when the window or the overlap is changed
+		auto windowSum = std::accumulate(window.begin(), window.begin() + fftSize, 0.0f);
+		magnitudeGain = windowSum > 0.0f ? 2.0f / windowSum : 1.0f;
 
-	//ptrdiff_t numHops = 1 + static_cast<long>((dataCount - fftSize) / hop);
+		currentWindow = method;
+	}
 
-	//size_t numRows = 1 + (fftSize / 2);
+	auto overlap = requestedOverlap.load();
+	if (overlap != currentOverlap)
+	{
+		//50% -> fftSize / 2, 75% -> fftSize / 4, 87.5% -> fftSize / 8
+		hopSize = fftSize >> (overlap + 1);
+		pollIntervalMs = juce::jmax(1, juce::roundToInt(500.0 * hopSize / sampleRate));
 
-	//std::vector<float> fftBuffer(fftSize * 2);
+		currentOverlap = overlap;
+	}
+}
 
-	//while(data > 0)
-	//{
-	//
-	//	memcpy(fftBuffer.data(), data, fftSize * sizeof(float));
+void STFTEngine::computeColumn()
+{
+	const auto fftSize = fft.getSize();
 
-	//	fWindow.multiplyWithWindowingTable(fftBuffer.data(), fftSize);	
-	//	fFft.performFrequencyOnlyForwardTransform(fftBuffer.data());
+	juce::FloatVectorOperations::multiply(fftBuffer.data(), frame.data(), window.data(), fftSize);
+	juce::FloatVectorOperations::clear(fftBuffer.data() + fftSize, fftSize);
 
+	fft.performFrequencyOnlyForwardTransform(fftBuffer.data());
 
+	juce::FloatVectorOperations::multiply(column.data(), fftBuffer.data(), magnitudeGain, (int)column.size());
 
-	//	data += hop;
-	//}
+	auto ok = columnFifo.push(column);
+	juce::ignoreUnused(ok);
 }
 
 //==============================================================================
@@ -263,6 +533,9 @@ juce::AudioProcessorValueTreeState::ParameterLayout Loudness_MeterAudioProcessor
 	//Representation Switch
 	params.push_back(std::make_unique<juce::AudioParameterChoice>("GRAFTYPE", "Graf Type", juce::StringArray{ "RMS", "Spectrogram" }, 1));
 
+	//Meter View, its own parameter so saved sessions and automation of GRAFTYPE keep their meaning
+	params.push_back(std::make_unique<juce::AudioParameterChoice>("METERVIEW", "Meter View", juce::StringArray{ "Analyzer", "PPM / VU" }, 0));
+
 	//Order Switch
 	params.push_back(std::make_unique<juce::AudioParameterChoice>("ORDERSWITCH", "Order Switch", juce::StringArray{ "Order 2048", "Order 4096", "Order 8192" }, 0));
 
@@ -284,6 +557,15 @@ juce::AudioProcessorValueTreeState::ParameterLayout Loudness_MeterAudioProcessor
 	//Level Offset Spectrogram
 	params.push_back(std::make_unique<juce::AudioParameterFloat>("LVLOFFSETSPECTR", "Level Offset Spectrogram", juce::NormalisableRange<float>{0.0f, 50.0f, 1.f}, 3.9f));
 
+	//STFT Overlap
+	params.push_back(std::make_unique<juce::AudioParameterChoice>("STFTOVERLAP", "STFT Overlap", juce::StringArray{ "Overlap 50%", "Overlap 75%", "Overlap 87.5%" }, 1));
+
+	//STFT Window
+	params.push_back(std::make_unique<juce::AudioParameterChoice>("STFTWINDOW", "STFT Window", juce::StringArray{ "Hann", "Hamming", "Blackman-Harris" }, 0));
+
+	//RMS / Peak Level Window
+	params.push_back(std::make_unique<juce::AudioParameterChoice>("LEVELWINDOW", "Level Window", juce::StringArray{ "Level 300 ms", "Level 3 s" }, 0));
+
 	//RMS Line Offset
 	params.push_back(std::make_unique<juce::AudioParameterFloat>("RMSLINEOFFSET", "RMS Line Offser", juce::NormalisableRange<float>{-200.0f, -1.0f, 1.0f}, -48.0f));
 
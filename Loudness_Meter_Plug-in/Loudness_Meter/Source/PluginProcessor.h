@@ -9,8 +9,16 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include "BallisticsMeter.h"
+#include "LevelMeter.h"
+#include "LoudnessMeter.h"
+#include "TruePeakMeter.h"
 
-template<typename T>
+/**
+ Queue of whole T's between one writer and one reader. Capacity - 1 of them fit,
+ push() fails (the new T is dropped) while the queue is full.
+ */
+template<typename T, int Capacity = 30>
 struct Fifo
 {
 	void prepare(int numChannels, int numSamples)
@@ -68,79 +76,321 @@ struct Fifo
 		return fifo.getNumReady();
 	}
 private:
-	static constexpr int Capacity = 30;
 	std::array<T, Capacity> buffers;
 	juce::AbstractFifo fifo{ Capacity };
 };
 
+/**
+ Wait-free single producer / single consumer handoff of the newest complete T.
+ The writer fills getWriteBuffer() and publishes it, the reader swaps in whatever
+ was published last. Neither side ever blocks, frames published while the reader
+ is busy are replaced by newer ones rather than queued.
+ */
+template<typename T>
+struct TripleBuffer
+{
+	//writer side
+	T& getWriteBuffer() { return buffers[writeIndex]; }
+
+	void publish()
+	{
+		auto previous = shared.exchange(writeIndex | newDataFlag, std::memory_order_acq_rel);
+		writeIndex = previous & indexMask;
+	}
+
+	//reader side
+	/** Takes ownership of the newest published buffer, false if nothing new arrived. */
+	bool pullLatest()
+	{
+		if ((shared.load(std::memory_order_relaxed) & newDataFlag) == 0)
+			return false;
+
+		auto previous = shared.exchange(readIndex, std::memory_order_acq_rel);
+		readIndex = previous & indexMask;
+		return true;
+	}
+
+	T& getReadBuffer() { return buffers[readIndex]; }
+private:
+	static constexpr int indexMask = 3;
+	static constexpr int newDataFlag = 4;
+
+	std::array<T, 3> buffers;
+	int writeIndex = 0;
+	int readIndex = 1;
+	std::atomic<int> shared{ 2 };
+};
+
 enum Channel
 {
 	Right,
 	Left
 };
 
+/**
+ Single producer / single consumer ring of samples for one channel.
+ The audio thread writes whatever block size the host hands it, the analysis
+ side pulls at its own hop size, so the two never have to agree on a chunk size.
+ */
 template<typename BlockType>
 struct SingleChannelSampleFifo
 {
-	SingleChannelSampleFifo(Channel ch) : channelToUse(ch)
+	SingleChannelSampleFifo(int ch) : channelToUse(ch)
 	{
 		prepared.set(false);
 	}
 
+	/** A buffer with fewer channels than channelToUse feeds its last channel instead, so a Left ring still works on a mono bus. */
 	void update(const BlockType& buffer)
 	{
 		jassert(prepared.get());
-		jassert(buffer.getNumChannels() > channelToUse);
-		auto* channelPtr = buffer.getReadPointer(channelToUse);
+		jassert(buffer.getNumChannels() > 0);
 
-		for (int i = 0; i < buffer.getNumSamples(); ++i)
-		{
-			pushNextSampleIntoFifo(channelPtr[i]);
-		}
+		auto numSamples = buffer.getNumSamples();
+		auto numToWrite = juce::jmin(numSamples, sampleFifo.getFreeSpace());
+
+		//the reader fell too far behind, let it know instead of losing samples silently
+		if (numToWrite < numSamples)
+			overflowed.set(true);
+
+		auto write = sampleFifo.write(numToWrite);
+		auto* channelPtr = buffer.getReadPointer(juce::jmin(channelToUse, buffer.getNumChannels() - 1));
+
+		if (write.blockSize1 > 0)
+			juce::FloatVectorOperations::copy(ringBuffer.getWritePointer(0, write.startIndex1), channelPtr, write.blockSize1);
+
+		if (write.blockSize2 > 0)
+			juce::FloatVectorOperations::copy(ringBuffer.getWritePointer(0, write.startIndex2), channelPtr + write.blockSize1, write.blockSize2);
 	}
 
-	void prepare(int bufferSize)
+	/** Sizes the ring. Neither the writer nor the reader may be using it meanwhile. */
+	void allocate(int capacity)
 	{
 		prepared.set(false);
-		size.set(bufferSize);
-
-		bufferToFill.setSize(1,             //channel
-			bufferSize,    //num samples
-			false,         //keepExistingContent
-			true,          //clear extra space
-			true);         //avoid reallocating
-		audioBufferFifo.prepare(1, bufferSize);
-		fifoIndex = 0;
+		size.set(capacity);
+
+		ringBuffer.setSize(1, capacity + 1); //AbstractFifo keeps one slot empty
+		ringBuffer.clear();
+		sampleFifo.setTotalSize(capacity + 1);
+		overflowed.set(false);
+	}
+
+	/** Empties the ring for a new stream, with the same rule as allocate(). */
+	void prepare()
+	{
+		jassert(size.get() > 0);
+
+		prepared.set(false);
+		sampleFifo.reset();
+		overflowed.set(false);
 		prepared.set(true);
 	}
+
+	/** Frees the ring of a channel nobody reads, with the same rule as allocate(). */
+	void release()
+	{
+		prepared.set(false);
+		size.set(0);
+		ringBuffer.setSize(1, 0);
+		sampleFifo.setTotalSize(1);
+	}
+	//==============================================================================
+	int getChannel() const { return channelToUse; }
 	//==============================================================================
-	int getNumCompleteBuffersAvailable() const { return audioBufferFifo.getNumAvailableForReading(); }
+	int getNumSamplesAvailable() const { return sampleFifo.getNumReady(); }
 	bool isPrepared() const { return prepared.get(); }
 	int getSize() const { return size.get(); }
 	//==============================================================================
-	bool getAudioBuffer(BlockType& buf) { return audioBufferFifo.pull(buf); }
+	/** Copies the next numSamples into dest, returns how many were actually there. */
+	int pullSamples(float* dest, int numSamples)
+	{
+		auto read = sampleFifo.read(juce::jmin(numSamples, sampleFifo.getNumReady()));
+
+		if (read.blockSize1 > 0)
+			juce::FloatVectorOperations::copy(dest, ringBuffer.getReadPointer(0, read.startIndex1), read.blockSize1);
+
+		if (read.blockSize2 > 0)
+			juce::FloatVectorOperations::copy(dest + read.blockSize1, ringBuffer.getReadPointer(0, read.startIndex2), read.blockSize2);
+
+		return read.blockSize1 + read.blockSize2;
+	}
+
+	/** True once after update() had to drop samples because the ring was full. */
+	bool checkAndClearOverflow() { return overflowed.exchange(false); }
+
+	/** Drops the oldest numToSkip samples, or all of them if there are fewer. */
+	void discardSamples(int numToSkip)
+	{
+		sampleFifo.finishedRead(juce::jlimit(0, sampleFifo.getNumReady(), numToSkip));
+	}
+
+	/** Drops the oldest samples so that at most numToKeep are left for reading. */
+	void discardOldest(int numToKeep)
+	{
+		auto numToSkip = sampleFifo.getNumReady() - numToKeep;
+
+		if (numToSkip > 0)
+			sampleFifo.finishedRead(numToSkip);
+	}
 private:
-	Channel channelToUse;
-	int fifoIndex = 0;
-	Fifo<BlockType> audioBufferFifo;
-	BlockType bufferToFill;
+	int channelToUse;
+	juce::AbstractFifo sampleFifo{ 1 };
+	BlockType ringBuffer;
 	juce::Atomic<bool> prepared = false;
+	juce::Atomic<bool> overflowed = false;
 	juce::Atomic<int> size = 0;
+};
 
-	void pushNextSampleIntoFifo(float sample)
+//==============================================================================
+/**
+ Block level silence detection for the analysis feeds, run on the audio thread.
+ Once every channel has peaked below the threshold for the hold time the analysis
+ goes idle, and the first block that crosses it wakes it again before that block
+ is pushed. The hold is longer than any analysis history, so by the time the feeds
+ stop every history already holds silence and the first frame after waking is
+ the same one a continuous analysis would have produced.
+ */
+struct SilenceDetector
+{
+	static constexpr float thresholdDb = -90.0f;
+	static constexpr double holdSeconds = 0.5;
+
+	void prepare(double sampleRate)
 	{
-		if (fifoIndex == bufferToFill.getNumSamples())
-		{
-			auto ok = audioBufferFifo.push(bufferToFill);
+		holdSamples = juce::roundToInt(sampleRate * holdSeconds);
+		reset();
+	}
 
-			juce::ignoreUnused(ok);
+	void reset()
+	{
+		silentSamples = 0;
+		idle.store(false);
+	}
 
-			fifoIndex = 0;
-		}
+	/** Returns true while the analysis should stay idle. */
+	bool process(const juce::AudioBuffer<float>& buffer, int numChannels)
+	{
+		const auto threshold = juce::Decibels::decibelsToGain(thresholdDb);
+		const auto numSamples = buffer.getNumSamples();
+
+		float peak = 0.0f;
+		for (int ch = 0; ch < numChannels; ++ch)
+			peak = juce::jmax(peak, buffer.getMagnitude(ch, 0, numSamples));
+
+		silentSamples = peak < threshold ? juce::jmin(silentSamples + numSamples, holdSamples) : 0;
+
+		const bool isIdle = silentSamples >= holdSamples;
+		idle.store(isIdle, std::memory_order_relaxed);
+		return isIdle;
+	}
+
+	bool isIdle() const { return idle.load(std::memory_order_relaxed); }
+private:
+	int holdSamples = 0;
+	int silentSamples = 0;
+	std::atomic<bool> idle{ false };
+};
+
+//==============================================================================
+/**
+ Short-time Fourier transform of one channel, computed on its own thread.
+ The audio thread only writes into the input ring. The worker advances by one hop
+ at a time, windows the newest fftSize samples and pushes one magnitude column per
+ hop, so columns stay evenly spaced in time whatever the host block size is.
+ */
+struct STFTEngine : private juce::Thread
+{
+	enum Overlap
+	{
+		overlap50,
+		overlap75,
+		overlap875
+	};
+
+	using WindowingMethod = juce::dsp::WindowingFunction<float>::WindowingMethod;
+
+	STFTEngine(int order, Channel ch);
+	~STFTEngine() override;
 
-		bufferToFill.setSample(0, fifoIndex, sample);
-		++fifoIndex;
+	/** Sizes the input ring, must not be called while the worker is running. */
+	void prepare(double sampleRate, int inputFifoSize);
+	void start();
+	void stop();
+	bool isRunning() const { return isThreadRunning(); }
+
+	//audio thread
+	void pushSamples(const juce::AudioBuffer<float>& buffer) { input.update(buffer); }
+
+	//any thread, picked up by the worker before its next hop
+	void setOverlap(Overlap overlap) { requestedOverlap.store(overlap); }
+	void setWindow(WindowingMethod method) { requestedWindow.store(method); }
+	//==============================================================================
+	int getFFTSize() const { return fft.getSize(); }
+	int getNumBins() const { return fft.getSize() / 2 + 1; }
+	int getNumColumnsAvailable() const { return columnFifo.getNumAvailableForReading(); }
+	//==============================================================================
+	/** Magnitudes from DC to Nyquist, normalised so a full scale sine reads 1. */
+	bool getColumn(std::vector<float>& column) { return columnFifo.pull(column); }
+private:
+	void run() override;
+	void updateConfiguration();
+	void computeColumn();
+
+	juce::dsp::FFT fft;
+	SingleChannelSampleFifo<juce::AudioBuffer<float>> input;
+
+	std::vector<float> window;
+	std::vector<float> frame;
+	std::vector<float> fftBuffer;
+	std::vector<float> column;
+
+	//Every column is a slice of the spectrogram's time axis, so they are queued
+	//rather than handed over as a latest value; the display itself still takes the
+	//newest finished image through a TripleBuffer. 128 columns cover about 680 ms
+	//of reader stall at 48 kHz with the smallest hop (256), 170 ms at 192 kHz.
+	static constexpr int columnQueueSize = 128;
+	Fifo<std::vector<float>, columnQueueSize> columnFifo;
+
+	std::atomic<int> requestedOverlap{ overlap75 };
+	std::atomic<int> requestedWindow{ WindowingMethod::hann };
+	int currentOverlap = -1;
+	int currentWindow = -1;
+
+	double sampleRate = 44100.0;
+	int hopSize = 0;
+	int pollIntervalMs = 1;
+	float magnitudeGain = 1.0f;
+};
+
+//==============================================================================
+/**
+ Plain copy of the APVTS values the editor cares about.
+ It is read from the raw parameter atomics, so taking one never locks and never
+ involves the audio thread.
+ */
+struct ParameterSnapshot
+{
+	int graftType = 0;
+	int meterView = 0;
+	int orderSwitch = 0;
+	int colourGridSwitch = 0;
+	int genreSpectr = 0;
+	int genreRMS = 0;
+	float rmsLineOffset = 0.0f;
+	float lvlKnobSpectr = 0.0f;
+	float skPropSpectr = 0.0f;
+	float lvlOffSpectr = 0.0f;
+
+	bool operator== (const ParameterSnapshot& other) const
+	{
+		return graftType == other.graftType && meterView == other.meterView && orderSwitch == other.orderSwitch
+			&& colourGridSwitch == other.colourGridSwitch && genreSpectr == other.genreSpectr
+			&& genreRMS == other.genreRMS && rmsLineOffset == other.rmsLineOffset
+			&& lvlKnobSpectr == other.lvlKnobSpectr && skPropSpectr == other.skPropSpectr
+			&& lvlOffSpectr == other.lvlOffSpectr;
 	}
+
+	bool operator!= (const ParameterSnapshot& other) const { return !(*this == other); }
 };
 
 //==============================================================================
@@ -188,11 +438,26 @@ public:
 
 	juce::AudioProcessorValueTreeState apvts;
 
+	//integrated loudness and LRA, paused while the host transport is stopped and
+	//reset when playback restarts from an earlier position
+	LoudnessIntegrator loudnessIntegrator;
+	//also clears the true-peak max-hold
+	void resetLoudnessIntegration() { loudnessResetRequested.store(true); }
+
+	//Safe to call from any thread, the GUI polls it once per frame
+	ParameterSnapshot getParameterSnapshot() const;
+
 	using BlockType = juce::AudioBuffer<float>;
-	SingleChannelSampleFifo<BlockType> leftChannelFifo{ Channel::Left };
-	SingleChannelSampleFifo<BlockType> rightChannelFifo{ Channel::Right };
 
-	SingleChannelSampleFifo<BlockType> spectrChannelFifo{ Channel::Left };
+	//samples each analysis ring can hold before the oldest ones are dropped
+	static int getAnalysisFifoSize(double sampleRate) { return juce::jmax(1 << 15, juce::nextPowerOfTwo((int)sampleRate)); }
+
+	static constexpr int maxAnalysisChannels = LoudnessMeter::maxChannels;
+
+	//One ring per input channel, only the first getNumAnalysisChannels() are prepared and
+	//only while the RMS feed has a reader. Read them with getAnalysisReadLock() held.
+	juce::OwnedArray<SingleChannelSampleFifo<BlockType>> channelFifos;
+	int getNumAnalysisChannels() const { return numAnalysisChannels.load(); }
 
 	enum
 	{
@@ -200,18 +465,74 @@ public:
 		fftSize = 1 << fftOrder //adds the ordet 10 into the binary number, so 10 extra zeros (00010000000000 = 1024)
 	};
 
-	float fifo[fftSize];
-	int fifoIndex = 0;
-	float fftData[2 * fftSize];
-	bool nextFFTBlockReady = false;
+	//momentary and short-term LUFS, always running
+	LoudnessMeter loudnessMeter;
+
+	//dBTP max-hold per channel
+	TruePeakMeter truePeakMeter;
+
+	//RMS and sample peak per channel, always running
+	LevelMeter levelMeter;
+	BallisticsMeter ballisticsMeter;
+
+	//spectrogram columns, computed off the audio thread
+	STFTEngine stftEngine{ fftOrder, Channel::Right };
+
+	//the RMS, spectrogram and STFT feeds pause while the input is silent
+	SilenceDetector silenceDetector;
+	bool isAnalysisIdle() const { return silenceDetector.isIdle(); }
+
+	//analysis feeds a reader can attach to, nothing is pushed into a feed nobody reads
+	enum AnalysisFeed
+	{
+		rmsFeed = 1 << 0,		//channelFifos
+		stftFeed = 1 << 1		//stftEngine
+	};
+
+	static constexpr int numAnalysisFeeds = 2;
+
+	//Not the audio thread. Every reader counts, so a feed keeps running until the
+	//last one attached to it is removed; the STFT thread only runs while stftFeed
+	//has a reader. The audio thread picks the change up at its next block.
+	void addAnalysisConsumer(int feeds);
+	void removeAnalysisConsumer(int feeds);
+	//feeds with at least one reader
+	int getAnalysisConsumers() const { return analysisConsumers.load(); }
+	//held by a reader for each pass over the rings, prepareToPlay waits for it before resetting them
+	const juce::CriticalSection& getAnalysisReadLock() const { return analysisConsumerLock; }
 
 private:
     
-	juce::dsp::FFT fFft;
-	juce::dsp::WindowingFunction<float> fWindow;
+	std::atomic<float>* graftTypeParam = nullptr;
+	std::atomic<float>* meterViewParam = nullptr;
+	std::atomic<float>* orderSwitchParam = nullptr;
+	std::atomic<float>* colourGridSwitchParam = nullptr;
+	std::atomic<float>* genreSpectrParam = nullptr;
+	std::atomic<float>* genreRMSParam = nullptr;
+	std::atomic<float>* rmsLineOffsetParam = nullptr;
+	std::atomic<float>* lvlKnobSpectrParam = nullptr;
+	std::atomic<float>* skPropSpectrParam = nullptr;
+	std::atomic<float>* lvlOffSpectrParam = nullptr;
+	std::atomic<float>* stftOverlapParam = nullptr;
+	std::atomic<float>* stftWindowParam = nullptr;
+	std::atomic<float>* levelWindowParam = nullptr;
+
+	std::atomic<int> numAnalysisChannels{ 0 };
+	std::atomic<int> analysisConsumers{ 0 };
+
+	//readers per feed, ring storage and the STFT thread's state, never touched by the audio thread
+	juce::CriticalSection analysisConsumerLock;
+	int numFeedConsumers[numAnalysisFeeds] = {};
+	bool analysisPrepared = false;
+	int analysisFifoSize = 0;
+	void prepareAnalysisRings();
+	void updateSTFTEngine();
+	std::atomic<bool> loudnessResetRequested{ false };
+	bool wasPlaying = false;
+	juce::int64 lastPlayedTimeInSamples = 0;
+
+	void updateLoudnessTransport();
 
-	void STFT(const juce::AudioSampleBuffer &, size_t);
-	void pushNextSampleIntoFifo(float) noexcept;
 	juce::AudioProcessorValueTreeState::ParameterLayout createParams();
 	
 	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (Loudness_MeterAudioProcessor)
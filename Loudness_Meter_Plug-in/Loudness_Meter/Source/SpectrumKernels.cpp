@@ -0,0 +1,234 @@
+/*
+  ==============================================================================
+
+    Vectorised per-bin kernels for the FFT data generators.
+
+  ==============================================================================
+*/
+
+#include "SpectrumKernels.h"
+
+#if defined(__AVX2__)
+ #include <immintrin.h>
+ #define SPECTRUM_USE_AVX2 1
+#elif JUCE_INTEL
+ #include <emmintrin.h>
+ #define SPECTRUM_USE_SSE 1
+#elif JUCE_ARM && (defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64))
+ #include <arm_neon.h>
+ #define SPECTRUM_USE_NEON 1
+#endif
+
+namespace
+{
+	//log2(1 + t) ~ t * (c1 + t * (c2 + t * (c3 + t * c4))) for t in [sqrt(0.5) - 1, sqrt(2) - 1)
+	constexpr float c1 = 1.4416473773835754f;
+	constexpr float c2 = -0.7249528374698105f;
+	constexpr float c3 = 0.5186204159460566f;
+	constexpr float c4 = -0.3300772160759019f;
+
+	constexpr float dbPerOctave = 6.020599913279624f;   //20 log10(2)
+	constexpr float sqrt2 = 1.4142135623730951f;
+	constexpr int mantissaMask = 0x007fffff;
+	constexpr int exponentOfOne = 0x3f800000;
+
+	//below this the result is clamped anyway, so the log never sees denormals or zero
+	float getMinimumGain(float negativeInfinity)
+	{
+		return juce::jmax(std::numeric_limits<float>::min(), (float)std::pow(10.0, negativeInfinity / 20.0));
+	}
+
+	inline float fastDecibels(float x, float minGain, float negativeInfinity)
+	{
+		if (!(x > minGain && x <= std::numeric_limits<float>::max()))
+			return negativeInfinity;
+
+		int bits;
+		std::memcpy(&bits, &x, sizeof(bits));
+
+		auto exponent = (float)((bits >> 23) - 127);
+		bits = (bits & mantissaMask) | exponentOfOne;
+
+		float mantissa;
+		std::memcpy(&mantissa, &bits, sizeof(mantissa));
+
+		if (mantissa > sqrt2)
+		{
+			mantissa *= 0.5f;
+			exponent += 1.0f;
+		}
+
+		const float t = mantissa - 1.0f;
+		const float log2 = exponent + t * (c1 + t * (c2 + t * (c3 + t * c4)));
+
+		return juce::jmax(negativeInfinity, log2 * dbPerOctave);
+	}
+
+	void magnitudesToDecibelsScalar(float* data, int numBins, float scale, float minGain, float negativeInfinity)
+	{
+		for (int i = 0; i < numBins; ++i)
+			data[i] = fastDecibels(data[i] * scale, minGain, negativeInfinity);
+	}
+}
+
+void SpectrumKernels::magnitudesToDecibelsReference(float* data, int numBins, float scale, float negativeInfinity)
+{
+	for (int i = 0; i < numBins; ++i)
+	{
+		auto v = data[i];
+		if (!std::isinf(v) && !std::isnan(v))
+			v *= scale;
+		else
+			v = 0.f;
+		data[i] = v;
+	}
+
+	for (int i = 0; i < numBins; ++i)
+		data[i] = juce::Decibels::gainToDecibels(data[i], negativeInfinity);
+}
+
+#if SPECTRUM_USE_AVX2
+void SpectrumKernels::magnitudesToDecibels(float* data, int numBins, float scale, float negativeInfinity)
+{
+	const float minGain = getMinimumGain(negativeInfinity);
+
+	const auto vScale = _mm256_set1_ps(scale);
+	const auto vMinGain = _mm256_set1_ps(minGain);
+	const auto vMaxGain = _mm256_set1_ps(std::numeric_limits<float>::max());
+	const auto vNegInf = _mm256_set1_ps(negativeInfinity);
+	const auto vSqrt2 = _mm256_set1_ps(sqrt2);
+	const auto vOne = _mm256_set1_ps(1.0f);
+	const auto vHalf = _mm256_set1_ps(0.5f);
+	const auto vMantissaMask = _mm256_set1_epi32(mantissaMask);
+	const auto vExponentOfOne = _mm256_set1_epi32(exponentOfOne);
+	const auto vBias = _mm256_set1_epi32(127);
+
+	int i = 0;
+	for (; i + 8 <= numBins; i += 8)
+	{
+		const auto x = _mm256_mul_ps(_mm256_loadu_ps(data + i), vScale);
+		const auto valid = _mm256_and_ps(_mm256_cmp_ps(x, vMinGain, _CMP_GT_OQ), _mm256_cmp_ps(x, vMaxGain, _CMP_LE_OQ));
+
+		const auto bits = _mm256_castps_si256(x);
+		auto exponent = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_srli_epi32(bits, 23), vBias));
+		auto mantissa = _mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(bits, vMantissaMask), vExponentOfOne));
+
+		const auto fold = _mm256_cmp_ps(mantissa, vSqrt2, _CMP_GT_OQ);
+		mantissa = _mm256_blendv_ps(mantissa, _mm256_mul_ps(mantissa, vHalf), fold);
+		exponent = _mm256_add_ps(exponent, _mm256_and_ps(fold, vOne));
+
+		const auto t = _mm256_sub_ps(mantissa, vOne);
+		auto poly = _mm256_add_ps(_mm256_set1_ps(c3), _mm256_mul_ps(t, _mm256_set1_ps(c4)));
+		poly = _mm256_add_ps(_mm256_set1_ps(c2), _mm256_mul_ps(t, poly));
+		poly = _mm256_add_ps(_mm256_set1_ps(c1), _mm256_mul_ps(t, poly));
+
+		const auto log2 = _mm256_add_ps(exponent, _mm256_mul_ps(t, poly));
+		const auto db = _mm256_max_ps(vNegInf, _mm256_mul_ps(log2, _mm256_set1_ps(dbPerOctave)));
+
+		_mm256_storeu_ps(data + i, _mm256_blendv_ps(vNegInf, db, valid));
+	}
+
+	magnitudesToDecibelsScalar(data + i, numBins - i, scale, minGain, negativeInfinity);
+}
+
+const char* SpectrumKernels::getKernelName() { return "AVX2"; }
+
+#elif SPECTRUM_USE_SSE
+void SpectrumKernels::magnitudesToDecibels(float* data, int numBins, float scale, float negativeInfinity)
+{
+	const float minGain = getMinimumGain(negativeInfinity);
+
+	const auto vScale = _mm_set1_ps(scale);
+	const auto vMinGain = _mm_set1_ps(minGain);
+	const auto vMaxGain = _mm_set1_ps(std::numeric_limits<float>::max());
+	const auto vNegInf = _mm_set1_ps(negativeInfinity);
+	const auto vSqrt2 = _mm_set1_ps(sqrt2);
+	const auto vOne = _mm_set1_ps(1.0f);
+	const auto vHalf = _mm_set1_ps(0.5f);
+	const auto vMantissaMask = _mm_set1_epi32(mantissaMask);
+	const auto vExponentOfOne = _mm_set1_epi32(exponentOfOne);
+	const auto vBias = _mm_set1_epi32(127);
+
+	int i = 0;
+	for (; i + 4 <= numBins; i += 4)
+	{
+		const auto x = _mm_mul_ps(_mm_loadu_ps(data + i), vScale);
+		const auto valid = _mm_and_ps(_mm_cmpgt_ps(x, vMinGain), _mm_cmple_ps(x, vMaxGain));
+
+		const auto bits = _mm_castps_si128(x);
+		auto exponent = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(bits, 23), vBias));
+		auto mantissa = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bits, vMantissaMask), vExponentOfOne));
+
+		//SSE2 has no blend, select with and / andnot
+		const auto fold = _mm_cmpgt_ps(mantissa, vSqrt2);
+		mantissa = _mm_or_ps(_mm_and_ps(fold, _mm_mul_ps(mantissa, vHalf)), _mm_andnot_ps(fold, mantissa));
+		exponent = _mm_add_ps(exponent, _mm_and_ps(fold, vOne));
+
+		const auto t = _mm_sub_ps(mantissa, vOne);
+		auto poly = _mm_add_ps(_mm_set1_ps(c3), _mm_mul_ps(t, _mm_set1_ps(c4)));
+		poly = _mm_add_ps(_mm_set1_ps(c2), _mm_mul_ps(t, poly));
+		poly = _mm_add_ps(_mm_set1_ps(c1), _mm_mul_ps(t, poly));
+
+		const auto log2 = _mm_add_ps(exponent, _mm_mul_ps(t, poly));
+		const auto db = _mm_max_ps(vNegInf, _mm_mul_ps(log2, _mm_set1_ps(dbPerOctave)));
+
+		_mm_storeu_ps(data + i, _mm_or_ps(_mm_and_ps(valid, db), _mm_andnot_ps(valid, vNegInf)));
+	}
+
+	magnitudesToDecibelsScalar(data + i, numBins - i, scale, minGain, negativeInfinity);
+}
+
+const char* SpectrumKernels::getKernelName() { return "SSE"; }
+
+#elif SPECTRUM_USE_NEON
+void SpectrumKernels::magnitudesToDecibels(float* data, int numBins, float scale, float negativeInfinity)
+{
+	const float minGain = getMinimumGain(negativeInfinity);
+
+	const auto vMinGain = vdupq_n_f32(minGain);
+	const auto vMaxGain = vdupq_n_f32(std::numeric_limits<float>::max());
+	const auto vNegInf = vdupq_n_f32(negativeInfinity);
+	const auto vSqrt2 = vdupq_n_f32(sqrt2);
+	const auto vOne = vdupq_n_f32(1.0f);
+	const auto vMantissaMask = vdupq_n_u32((uint32_t)mantissaMask);
+	const auto vExponentOfOne = vdupq_n_u32((uint32_t)exponentOfOne);
+	const auto vBias = vdupq_n_s32(127);
+
+	int i = 0;
+	for (; i + 4 <= numBins; i += 4)
+	{
+		const auto x = vmulq_n_f32(vld1q_f32(data + i), scale);
+		const auto valid = vandq_u32(vcgtq_f32(x, vMinGain), vcleq_f32(x, vMaxGain));
+
+		const auto bits = vreinterpretq_u32_f32(x);
+		auto exponent = vcvtq_f32_s32(vsubq_s32(vreinterpretq_s32_u32(vshrq_n_u32(bits, 23)), vBias));
+		auto mantissa = vreinterpretq_f32_u32(vorrq_u32(vandq_u32(bits, vMantissaMask), vExponentOfOne));
+
+		const auto fold = vcgtq_f32(mantissa, vSqrt2);
+		mantissa = vbslq_f32(fold, vmulq_n_f32(mantissa, 0.5f), mantissa);
+		exponent = vbslq_f32(fold, vaddq_f32(exponent, vOne), exponent);
+
+		const auto t = vsubq_f32(mantissa, vOne);
+		auto poly = vmlaq_n_f32(vdupq_n_f32(c3), t, c4);
+		poly = vmlaq_f32(vdupq_n_f32(c2), t, poly);
+		poly = vmlaq_f32(vdupq_n_f32(c1), t, poly);
+
+		const auto log2 = vmlaq_f32(exponent, t, poly);
+		const auto db = vmaxq_f32(vNegInf, vmulq_n_f32(log2, dbPerOctave));
+
+		vst1q_f32(data + i, vbslq_f32(valid, db, vNegInf));
+	}
+
+	magnitudesToDecibelsScalar(data + i, numBins - i, scale, minGain, negativeInfinity);
+}
+
+const char* SpectrumKernels::getKernelName() { return "NEON"; }
+
+#else
+void SpectrumKernels::magnitudesToDecibels(float* data, int numBins, float scale, float negativeInfinity)
+{
+	magnitudesToDecibelsScalar(data, numBins, scale, getMinimumGain(negativeInfinity), negativeInfinity);
+}
+
+const char* SpectrumKernels::getKernelName() { return "scalar"; }
+#endif
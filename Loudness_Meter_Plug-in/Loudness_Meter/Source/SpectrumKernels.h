@@ -0,0 +1,36 @@
+/*
+  ==============================================================================
+
+    Vectorised per-bin kernels for the FFT data generators.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+/**
+ Turns FFT magnitudes into the dB values the analyzers draw, in one pass:
+ non-finite bins are dropped, the rest are scaled and converted with a
+ polynomial log2 instead of one log10 per bin.
+
+ The log2 works on the float's exponent and mantissa, with the mantissa folded
+ into [sqrt(0.5), sqrt(2)) and a degree 4 least squares fit. Its error is below
+ 0.0007 dB everywhere above negativeInfinity, maxErrorDb leaves room for rounding.
+ */
+struct SpectrumKernels
+{
+	static constexpr float maxErrorDb = 0.001f;
+
+	/**
+	 data[i] = 20 log10(data[i] * scale), clamped to negativeInfinity.
+	 NaN, infinite and non-positive magnitudes become negativeInfinity.
+	 */
+	static void magnitudesToDecibels(float* data, int numBins, float scale, float negativeInfinity);
+
+	/** The original sanitise loop followed by juce::Decibels::gainToDecibels per bin. */
+	static void magnitudesToDecibelsReference(float* data, int numBins, float scale, float negativeInfinity);
+
+	static const char* getKernelName();
+};
@@ -0,0 +1,239 @@
+/*
+  ==============================================================================
+
+    ITU-R BS.1770-4 Annex 2 true-peak measurement.
+
+  ==============================================================================
+*/
+
+#include "TruePeakMeter.h"
+
+#if defined(__AVX__)
+ #include <immintrin.h>
+ #define TRUE_PEAK_USE_AVX 1
+#elif JUCE_INTEL
+ #include <emmintrin.h>
+ #define TRUE_PEAK_USE_SSE 1
+#elif JUCE_ARM && (defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64))
+ #include <arm_neon.h>
+ #define TRUE_PEAK_USE_NEON 1
+#endif
+
+namespace
+{
+	//BS.1770-4 Annex 2, phase k uses taps k, k + 4, k + 8 ... of the 48 tap filter
+	alignas(32) const float coefficients[TruePeakMeter::oversampling][TruePeakMeter::tapsPerPhase] =
+	{
+		{  0.0017089843750f,  0.0109863281250f, -0.0196533203125f,  0.0332031250000f, -0.0594482421875f,  0.1373291015625f,
+		   0.9721679687500f, -0.1022949218750f,  0.0476074218750f, -0.0266113281250f,  0.0148925781250f, -0.0083007812500f },
+		{ -0.0291748046875f,  0.0292968750000f, -0.0517578125000f,  0.0891113281250f, -0.1665039062500f,  0.4650878906250f,
+		   0.7797851562500f, -0.2003173828125f,  0.1015625000000f, -0.0582275390625f,  0.0330810546875f, -0.0189208984375f },
+		{ -0.0189208984375f,  0.0330810546875f, -0.0582275390625f,  0.1015625000000f, -0.2003173828125f,  0.7797851562500f,
+		   0.4650878906250f, -0.1665039062500f,  0.0891113281250f, -0.0517578125000f,  0.0292968750000f, -0.0291748046875f },
+		{ -0.0083007812500f,  0.0148925781250f, -0.0266113281250f,  0.0476074218750f, -0.1022949218750f,  0.9721679687500f,
+		   0.1373291015625f, -0.0594482421875f,  0.0332031250000f, -0.0196533203125f,  0.0109863281250f,  0.0017089843750f }
+	};
+}
+
+TruePeakMeter::TruePeakMeter()
+{
+	for (auto& h : history)
+		h.fill(0.0f);
+
+	for (auto& m : maxHold)
+		m.store(0.0f);
+}
+
+void TruePeakMeter::prepare(int newNumChannels, int maximumBlockSize)
+{
+	jassert(newNumChannels <= maxChannels);
+
+	numChannels = juce::jlimit(0, maxChannels, newNumChannels);
+	scratchSize = juce::jmax(64, maximumBlockSize);
+	scratch.assign((size_t)(historySize + scratchSize), 0.0f);
+
+	for (auto& h : history)
+		h.fill(0.0f);
+
+	for (auto& m : maxHold)
+		m.store(0.0f);
+}
+
+void TruePeakMeter::process(const juce::AudioBuffer<float>& buffer)
+{
+	jassert(buffer.getNumChannels() >= numChannels);
+
+	if (resetRequested.exchange(false))
+		for (auto& m : maxHold)
+			m.store(0.0f, std::memory_order_relaxed);
+
+	const int numSamples = buffer.getNumSamples();
+	auto* input = scratch.data() + historySize;
+
+	for (int ch = 0; ch < numChannels; ++ch)
+	{
+		auto* channelData = buffer.getReadPointer(ch);
+		auto& channelHistory = history[(size_t)ch];
+		float peak = 0.0f;
+
+		//the scratch buffer puts the history right in front of the new samples,
+		//hosts that go over the prepared block size are handled in chunks
+		for (int start = 0; start < numSamples; start += scratchSize)
+		{
+			const int numThisTime = juce::jmin(scratchSize, numSamples - start);
+
+			std::copy(channelHistory.begin(), channelHistory.end(), scratch.begin());
+			juce::FloatVectorOperations::copy(input, channelData + start, numThisTime);
+
+			peak = juce::jmax(peak, findPeak(input, numThisTime));
+
+			std::copy(input + numThisTime - historySize, input + numThisTime, channelHistory.begin());
+		}
+
+		//single writer, no need for a compare and swap
+		if (peak > maxHold[ch].load(std::memory_order_relaxed))
+			maxHold[ch].store(peak, std::memory_order_relaxed);
+	}
+}
+
+float TruePeakMeter::getMaxHold(int channel) const
+{
+	return juce::isPositiveAndBelow(channel, maxChannels) ? maxHold[channel].load(std::memory_order_relaxed) : 0.0f;
+}
+
+float TruePeakMeter::getMaxHold() const
+{
+	float peak = 0.0f;
+
+	for (auto& m : maxHold)
+		peak = juce::jmax(peak, m.load(std::memory_order_relaxed));
+
+	return peak;
+}
+
+float TruePeakMeter::findPeakScalar(const float* samples, int numSamples)
+{
+	float peak = 0.0f;
+
+	for (int n = 0; n < numSamples; ++n)
+	{
+		for (int k = 0; k < oversampling; ++k)
+		{
+			float acc = 0.0f;
+
+			for (int j = 0; j < tapsPerPhase; ++j)
+				acc += coefficients[k][j] * samples[n - j];
+
+			peak = juce::jmax(peak, std::abs(acc));
+		}
+	}
+
+	return peak;
+}
+
+#if TRUE_PEAK_USE_AVX
+float TruePeakMeter::findPeak(const float* samples, int numSamples)
+{
+	//eight consecutive outputs of one phase per register
+	const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+	__m256 peak = _mm256_setzero_ps();
+
+	int n = 0;
+	for (; n + 8 <= numSamples; n += 8)
+	{
+		//the same twelve input vectors feed all four phases
+		__m256 x[tapsPerPhase];
+		for (int j = 0; j < tapsPerPhase; ++j)
+			x[j] = _mm256_loadu_ps(samples + n - j);
+
+		for (int k = 0; k < oversampling; ++k)
+		{
+			__m256 acc = _mm256_setzero_ps();
+
+			for (int j = 0; j < tapsPerPhase; ++j)
+				acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_set1_ps(coefficients[k][j]), x[j]));
+
+			peak = _mm256_max_ps(peak, _mm256_and_ps(acc, absMask));
+		}
+	}
+
+	alignas(32) float lanes[8];
+	_mm256_store_ps(lanes, peak);
+
+	return juce::jmax(*std::max_element(std::begin(lanes), std::end(lanes)), findPeakScalar(samples + n, numSamples - n));
+}
+
+const char* TruePeakMeter::getKernelName() { return "AVX"; }
+
+#elif TRUE_PEAK_USE_SSE
+float TruePeakMeter::findPeak(const float* samples, int numSamples)
+{
+	//four consecutive outputs of one phase per register
+	const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+	__m128 peak = _mm_setzero_ps();
+
+	int n = 0;
+	for (; n + 4 <= numSamples; n += 4)
+	{
+		__m128 x[tapsPerPhase];
+		for (int j = 0; j < tapsPerPhase; ++j)
+			x[j] = _mm_loadu_ps(samples + n - j);
+
+		for (int k = 0; k < oversampling; ++k)
+		{
+			__m128 acc = _mm_setzero_ps();
+
+			for (int j = 0; j < tapsPerPhase; ++j)
+				acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(coefficients[k][j]), x[j]));
+
+			peak = _mm_max_ps(peak, _mm_and_ps(acc, absMask));
+		}
+	}
+
+	alignas(16) float lanes[4];
+	_mm_store_ps(lanes, peak);
+
+	return juce::jmax(*std::max_element(std::begin(lanes), std::end(lanes)), findPeakScalar(samples + n, numSamples - n));
+}
+
+const char* TruePeakMeter::getKernelName() { return "SSE"; }
+
+#elif TRUE_PEAK_USE_NEON
+float TruePeakMeter::findPeak(const float* samples, int numSamples)
+{
+	float32x4_t peak = vdupq_n_f32(0.0f);
+
+	int n = 0;
+	for (; n + 4 <= numSamples; n += 4)
+	{
+		float32x4_t x[tapsPerPhase];
+		for (int j = 0; j < tapsPerPhase; ++j)
+			x[j] = vld1q_f32(samples + n - j);
+
+		for (int k = 0; k < oversampling; ++k)
+		{
+			float32x4_t acc = vdupq_n_f32(0.0f);
+
+			for (int j = 0; j < tapsPerPhase; ++j)
+				acc = vmlaq_n_f32(acc, x[j], coefficients[k][j]);
+
+			peak = vmaxq_f32(peak, vabsq_f32(acc));
+		}
+	}
+
+	float lanes[4];
+	vst1q_f32(lanes, peak);
+
+	return juce::jmax(*std::max_element(std::begin(lanes), std::end(lanes)), findPeakScalar(samples + n, numSamples - n));
+}
+
+const char* TruePeakMeter::getKernelName() { return "NEON"; }
+
+#else
+float TruePeakMeter::findPeak(const float* samples, int numSamples)
+{
+	return findPeakScalar(samples, numSamples);
+}
+
+const char* TruePeakMeter::getKernelName() { return "scalar"; }
+#endif
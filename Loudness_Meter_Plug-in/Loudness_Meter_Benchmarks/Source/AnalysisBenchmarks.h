@@ -0,0 +1,206 @@
+/*
+  ==============================================================================
+
+    Message-thread cost of the FFT, path and spectrogram rendering paths.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "BenchmarkHarness.h"
+#include "FifoBenchmarks.h"
+#include "../../Loudness_Meter/Source/PluginEditor.h"
+
+namespace AnalysisBenchmarks
+{
+	constexpr FFTOrder orders[] = { FFTOrder::order2048, FFTOrder::order4096, FFTOrder::order8192 };
+	constexpr float negativeInfinity = -48.0f;
+	constexpr double sampleRate = 48000.0;
+
+	inline juce::String toString(juce::Rectangle<int> size)
+	{
+		return juce::String(size.getWidth()) + "x" + juce::String(size.getHeight());
+	}
+
+	//a few partials over noise, so the frames look like real programme
+	inline juce::AudioBuffer<float> makeFrame(int fftSize)
+	{
+		juce::Random random(1);
+		juce::AudioBuffer<float> frame(1, fftSize);
+
+		for (int i = 0; i < fftSize; ++i)
+		{
+			float v = 0.05f * (random.nextFloat() * 2.0f - 1.0f);
+
+			for (auto freq : { 110.0, 1000.0, 7000.0 })
+				v += 0.3f * (float)std::sin(juce::MathConstants<double>::twoPi * freq * i / sampleRate);
+
+			frame.setSample(0, i, v);
+		}
+
+		return frame;
+	}
+
+	//one frame of dB data as the editor would hand it to the generators
+	inline std::vector<float> makeRenderData(FFTOrder order)
+	{
+		FFTDataGeneratorRMS<std::vector<float>> generator;
+		generator.changeOrder(order);
+		generator.produceFFTDataForRendering(makeFrame(generator.getFFTSize()), negativeInfinity);
+
+		std::vector<float> renderData;
+		generator.getFFTData(renderData);
+		return renderData;
+	}
+
+	//linear magnitudes, like the STFT engine's columns
+	inline std::vector<float> makeColumn(FFTOrder order)
+	{
+		auto renderData = makeRenderData(order);
+		std::vector<float> column((size_t)(1 << order) / 2 + 1);
+
+		for (size_t i = 0; i < column.size(); ++i)
+			column[i] = juce::Decibels::decibelsToGain(renderData[juce::jmin(i, renderData.size() - 1)], negativeInfinity);
+
+		return column;
+	}
+
+	inline void timeProduceFFTData(FFTOrder order)
+	{
+		FFTDataGeneratorRMS<std::vector<float>> generator;
+		generator.changeOrder(order);
+
+		auto frame = makeFrame(generator.getFFTSize());
+		std::vector<float> drained;
+
+		auto ns = measureNsPerCall(2000, [&]
+		{
+			generator.produceFFTDataForRendering(frame, negativeInfinity);
+			generator.getFFTData(drained);
+		});
+
+		printResult({ "FFTDataGeneratorRMS::produceFFTDataForRendering", (int)order, ns });
+	}
+
+	//one packed FFT for a channel pair against two mono frames, and how far apart they land
+	inline void timeStereoFFTData(FFTOrder order)
+	{
+		FFTDataGeneratorRMS<std::vector<float>> mono;
+		StereoFFTDataGeneratorRMS<std::vector<float>> stereo;
+		mono.changeOrder(order);
+		stereo.changeOrder(order);
+
+		const int fftSize = 1 << order;
+		auto left = makeFrame(fftSize);
+		juce::AudioBuffer<float> right(1, fftSize);
+
+		//a different signal on the right, so any leakage between the channels shows up
+		for (int i = 0; i < fftSize; ++i)
+			right.setSample(0, i, 0.5f * (float)std::sin(juce::MathConstants<double>::twoPi * 3000.0 * i / sampleRate));
+
+		std::vector<float> monoData[2], stereoData[2];
+
+		mono.produceFFTDataForRendering(left, negativeInfinity);
+		mono.getFFTData(monoData[0]);
+		mono.produceFFTDataForRendering(right, negativeInfinity);
+		mono.getFFTData(monoData[1]);
+
+		stereo.produceFFTDataForRendering(left.getReadPointer(0), right.getReadPointer(0), negativeInfinity);
+		stereo.getFFTData(stereoData[0], stereoData[1]);
+
+		//compared as linear magnitudes, relative to the loudest bin of the frame
+		for (int ch = 0; ch < 2; ++ch)
+		{
+			const int numBins = fftSize / 2;
+			float peak = 0.0f, maxError = 0.0f;
+
+			for (int k = 0; k < numBins; ++k)
+				peak = juce::jmax(peak, juce::Decibels::decibelsToGain(monoData[ch][(size_t)k], -200.0f));
+
+			for (int k = 0; k < numBins; ++k)
+				maxError = juce::jmax(maxError, std::abs(juce::Decibels::decibelsToGain(monoData[ch][(size_t)k], -200.0f)
+														 - juce::Decibels::decibelsToGain(stereoData[ch][(size_t)k], -200.0f)));
+
+			if (maxError > 1.0e-4f * peak)
+			{
+				std::cout << "StereoFFTDataGeneratorRMS channel " << ch << " is off by " << maxError / peak << " of the peak at order " << (int)order << std::endl;
+				jassertfalse;
+			}
+		}
+
+		auto monoNs = measureNsPerCall(2000, [&]
+		{
+			mono.produceFFTDataForRendering(left, negativeInfinity);
+			mono.getFFTData(monoData[0]);
+			mono.produceFFTDataForRendering(right, negativeInfinity);
+			mono.getFFTData(monoData[1]);
+		});
+
+		auto stereoNs = measureNsPerCall(2000, [&]
+		{
+			stereo.produceFFTDataForRendering(left.getReadPointer(0), right.getReadPointer(0), negativeInfinity);
+			stereo.getFFTData(stereoData[0], stereoData[1]);
+		});
+
+		printResult({ "FFTDataGeneratorRMS::produceFFTDataForRendering x2", (int)order, monoNs });
+		printResult({ "StereoFFTDataGeneratorRMS::produceFFTDataForRendering", (int)order, stereoNs });
+	}
+
+	inline void timeGeneratePath(FFTOrder order, juce::Rectangle<int> size)
+	{
+		AnalyzerPathGenerator<juce::Path> generator;
+		auto renderData = makeRenderData(order);
+		const int fftSize = 1 << order;
+		const float binWidth = (float)(sampleRate / fftSize);
+		juce::Path path;
+
+		auto ns = measureNsPerCall(2000, [&]
+		{
+			generator.generatePath(renderData, size.toFloat(), fftSize, binWidth, negativeInfinity);
+			generator.getPath(path);
+		});
+
+		printResult({ "AnalyzerPathGenerator::generatePath", (int)order, ns, toString(size) });
+	}
+
+	inline void timeDrawNextLineOfSpectrogram(FFTOrder order, juce::Rectangle<int> size)
+	{
+		SpectrogramRenderer renderer(size.getWidth(), size.getHeight());
+		auto column = makeColumn(order);
+
+		auto ns = measureNsPerCall(200, [&]
+		{
+			renderer.drawNextLineOfSpectrogram(column, 0.00001f, 0.2f, 3.9f);
+		});
+
+		printResult({ "SpectrogramAndRMSRep::drawNextLineOfSpectrogram", (int)order, ns, toString(size) });
+	}
+}
+
+/**
+ Every hot path at FFT orders 11 to 13, the rendering ones also at several sizes.
+ fps is calls per second, i.e. the frame rate one analyzer could sustain on its own.
+ */
+inline void runAnalysisBenchmarks()
+{
+	using namespace AnalysisBenchmarks;
+
+	const juce::Rectangle<int> pathSizes[] = { { 400, 200 }, { 800, 400 }, { 1600, 800 } };
+	const juce::Rectangle<int> imageSizes[] = { { 256, 256 }, { 512, 512 }, { 1024, 1024 } };
+
+	for (auto order : orders)
+	{
+		printResult({ "SingleChannelSampleFifo::update one frame", (int)order,
+					  timeFifoUpdate<SampleRingFifo>(1 << order) });
+
+		timeProduceFFTData(order);
+		timeStereoFFTData(order);
+
+		for (auto size : pathSizes)
+			timeGeneratePath(order, size);
+
+		for (auto size : imageSizes)
+			timeDrawNextLineOfSpectrogram(order, size);
+	}
+}
@@ -0,0 +1,93 @@
+/*
+  ==============================================================================
+
+    Small timing helpers shared by the benchmarks.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+struct BenchmarkResult
+{
+	juce::String name;
+	int param = 0;
+	double nsPerCall = 0.0;
+	juce::String config;   //render size etc., empty if there is only 'param'
+
+	double getCallsPerSecond() const { return nsPerCall > 0.0 ? 1.0e9 / nsPerCall : 0.0; }
+};
+
+/**
+ Runs 'fn' once to warm up, then times 'numCalls' calls and returns ns per call.
+ */
+template<typename Function>
+double measureNsPerCall(int numCalls, Function&& fn)
+{
+	fn();
+
+	auto start = juce::Time::getHighResolutionTicks();
+
+	for (int i = 0; i < numCalls; ++i)
+		fn();
+
+	auto elapsed = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - start);
+
+	return elapsed * 1.0e9 / (double)numCalls;
+}
+
+/** Everything printed so far, in order, for the machine readable output. */
+inline std::vector<BenchmarkResult>& getRecordedResults()
+{
+	static std::vector<BenchmarkResult> results;
+	return results;
+}
+
+inline void printResult(const BenchmarkResult& result)
+{
+	getRecordedResults().push_back(result);
+
+	std::cout << result.name << " [" << result.param;
+
+	if (result.config.isNotEmpty())
+		std::cout << ", " << result.config;
+
+	std::cout << "]: " << juce::String(result.nsPerCall, 1) << " ns/call, "
+		<< juce::String(result.getCallsPerSecond(), 1) << " fps" << std::endl;
+}
+
+inline bool writeResultsAsJson(const juce::File& file)
+{
+	juce::Array<juce::var> entries;
+
+	for (auto& result : getRecordedResults())
+	{
+		auto* entry = new juce::DynamicObject();
+		entry->setProperty("name", result.name);
+		entry->setProperty("param", result.param);
+		entry->setProperty("config", result.config);
+		entry->setProperty("nsPerCall", result.nsPerCall);
+		entry->setProperty("fps", result.getCallsPerSecond());
+		entries.add(juce::var(entry));
+	}
+
+	auto* root = new juce::DynamicObject();
+	root->setProperty("version", ProjectInfo::versionString);
+	root->setProperty("cpu", juce::SystemStats::getCpuModel());
+	root->setProperty("results", entries);
+
+	return file.replaceWithText(juce::JSON::toString(juce::var(root)));
+}
+
+inline bool writeResultsAsCsv(const juce::File& file)
+{
+	juce::String csv("name,param,config,ns_per_call,fps\n");
+
+	for (auto& result : getRecordedResults())
+		csv << result.name.quoted() << ',' << result.param << ',' << result.config.quoted() << ','
+			<< juce::String(result.nsPerCall, 3) << ',' << juce::String(result.getCallsPerSecond(), 3) << '\n';
+
+	return file.replaceWithText(csv);
+}
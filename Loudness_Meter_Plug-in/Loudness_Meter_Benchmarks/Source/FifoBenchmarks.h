@@ -0,0 +1,167 @@
+/*
+  ==============================================================================
+
+    Audio-thread cost of feeding the analysis FIFOs.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "BenchmarkHarness.h"
+#include "../../Loudness_Meter/Source/PluginProcessor.h"
+
+/**
+ The old SingleChannelSampleFifo::update, one bounds check and setSample() per
+ sample into a 30-slot buffer-of-buffers. Kept here to time the sample ring against it.
+ */
+struct PerSampleReferenceFifo
+{
+	PerSampleReferenceFifo(Channel ch) : channelToUse(ch) {}
+
+	void prepare(int bufferSize)
+	{
+		bufferToFill.setSize(1, bufferSize, false, true, true);
+		audioBufferFifo.prepare(1, bufferSize);
+		fifoIndex = 0;
+	}
+
+	void update(const juce::AudioBuffer<float>& buffer)
+	{
+		auto* channelPtr = buffer.getReadPointer(channelToUse);
+
+		for (int i = 0; i < buffer.getNumSamples(); ++i)
+			pushNextSampleIntoFifo(channelPtr[i]);
+	}
+
+	void drain()
+	{
+		while (audioBufferFifo.pull(drained)) {}
+	}
+
+private:
+	Channel channelToUse;
+	int fifoIndex = 0;
+	Fifo<juce::AudioBuffer<float>> audioBufferFifo;
+	juce::AudioBuffer<float> bufferToFill, drained;
+
+	void pushNextSampleIntoFifo(float sample)
+	{
+		if (fifoIndex == bufferToFill.getNumSamples())
+		{
+			audioBufferFifo.push(bufferToFill);
+			fifoIndex = 0;
+		}
+
+		bufferToFill.setSample(0, fifoIndex, sample);
+		++fifoIndex;
+	}
+};
+
+struct SampleRingFifo : SingleChannelSampleFifo<juce::AudioBuffer<float>>
+{
+	using SingleChannelSampleFifo::SingleChannelSampleFifo;
+
+	void prepare(int capacity)
+	{
+		allocate(capacity);
+		SingleChannelSampleFifo::prepare();
+	}
+
+	void drain() { discardOldest(0); }
+};
+
+inline void fillWithNoise(juce::AudioBuffer<float>& buffer, juce::Random& random)
+{
+	for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
+		for (int i = 0; i < buffer.getNumSamples(); ++i)
+			buffer.setSample(ch, i, random.nextFloat() * 2.0f - 1.0f);
+}
+
+/**
+ Writes blocks whose size changes on every call and reads them back at a fixed hop,
+ the stream coming out has to be the stream that went in.
+ */
+inline bool sampleRingPreservesStream(int maxBlockSize, int hopSize)
+{
+	juce::Random random(maxBlockSize);
+
+	SingleChannelSampleFifo<juce::AudioBuffer<float>> ring{ Channel::Left };
+	ring.allocate(1 << 15);
+	ring.prepare();
+
+	juce::Array<float> written;
+	std::vector<float> hop((size_t)hopSize);
+	int numRead = 0;
+
+	for (int n = 0; n < 500; ++n)
+	{
+		juce::AudioBuffer<float> block(2, 1 + random.nextInt(maxBlockSize));
+		fillWithNoise(block, random);
+		ring.update(block);
+		written.addArray(block.getReadPointer(Channel::Left), block.getNumSamples());
+
+		while (ring.getNumSamplesAvailable() >= hopSize)
+		{
+			ring.pullSamples(hop.data(), hopSize);
+
+			for (int i = 0; i < hopSize; ++i)
+				if (hop[(size_t)i] != written[numRead + i])
+					return false;
+
+			numRead += hopSize;
+		}
+	}
+
+	return !ring.checkAndClearOverflow();
+}
+
+/**
+ ns per processBlock-sized update, per FIFO. The FIFOs are drained outside the
+ timed region every few blocks so nothing is ever dropped because they are full.
+ */
+template<typename FifoType>
+double timeFifoUpdate(int blockSize)
+{
+	constexpr int blocksPerBatch = 16;
+	constexpr int numBatches = 2000;
+
+	juce::Random random(1);
+	juce::AudioBuffer<float> block(2, blockSize);
+	fillWithNoise(block, random);
+
+	FifoType fifo{ Channel::Left };
+	fifo.prepare(std::is_same_v<FifoType, PerSampleReferenceFifo> ? blockSize : juce::jmax(1 << 16, blocksPerBatch * blockSize));
+
+	double totalNs = 0.0;
+
+	for (int batch = 0; batch < numBatches; ++batch)
+	{
+		totalNs += measureNsPerCall(blocksPerBatch, [&] { fifo.update(block); }) * blocksPerBatch;
+
+		fifo.drain();
+	}
+
+	return totalNs / double(numBatches * blocksPerBatch);
+}
+
+inline void runFifoBenchmarks()
+{
+	for (auto blockSize : { 32, 256, 2048 })
+	{
+		for (auto hopSize : { 256, 512, 1000 })
+		{
+			if (!sampleRingPreservesStream(blockSize, hopSize))
+			{
+				std::cout << "SingleChannelSampleFifo lost or reordered samples for block size "
+					<< blockSize << ", hop " << hopSize << std::endl;
+				jassertfalse;
+			}
+		}
+
+		printResult({ "SingleChannelSampleFifo::update per-sample", blockSize,
+					  timeFifoUpdate<PerSampleReferenceFifo>(blockSize) });
+		printResult({ "SingleChannelSampleFifo::update sample ring", blockSize,
+					  timeFifoUpdate<SampleRingFifo>(blockSize) });
+	}
+}
@@ -0,0 +1,45 @@
+/*
+  ==============================================================================
+
+    Micro-benchmarks for the Loudness_Meter analysis hot paths.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "AnalysisBenchmarks.h"
+#include "FifoBenchmarks.h"
+#include "SpectrumBenchmarks.h"
+#include "TruePeakBenchmarks.h"
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+	juce::File jsonFile, csvFile;
+
+	//--json / --csv write every result for tracking regressions between releases
+	for (int i = 1; i + 1 < argc; ++i)
+	{
+		const juce::String arg(argv[i]);
+
+		if (arg == "--json")
+			jsonFile = juce::File::getCurrentWorkingDirectory().getChildFile(argv[++i]);
+		else if (arg == "--csv")
+			csvFile = juce::File::getCurrentWorkingDirectory().getChildFile(argv[++i]);
+	}
+
+	runFifoBenchmarks();
+	runTruePeakBenchmarks();
+	runSpectrumBenchmarks();
+	runAnalysisBenchmarks();
+
+	bool ok = true;
+
+	if (jsonFile != juce::File())
+		ok = writeResultsAsJson(jsonFile) && ok;
+
+	if (csvFile != juce::File())
+		ok = writeResultsAsCsv(csvFile) && ok;
+
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,67 @@
+/*
+  ==============================================================================
+
+    Fused dB kernel against the original sanitise + gainToDecibels loops.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "BenchmarkHarness.h"
+#include "../../Loudness_Meter/Source/SpectrumKernels.h"
+
+inline void runSpectrumBenchmarks()
+{
+	juce::Random random(5);
+	constexpr float negativeInfinity = -48.0f;
+
+	for (auto numBins : { 1024, 2048, 4096 })
+	{
+		//FFT magnitudes from -140 to +20 dB, plus the odd NaN / Inf the sanitising is for
+		std::vector<float> magnitudes((size_t)numBins);
+		for (auto& m : magnitudes)
+			m = juce::Decibels::decibelsToGain(random.nextFloat() * 160.0f - 140.0f, -200.0f) * (float)numBins;
+
+		magnitudes[1] = std::numeric_limits<float>::quiet_NaN();
+		magnitudes[2] = std::numeric_limits<float>::infinity();
+
+		const float scale = 1.0f / (float)numBins;
+		auto reference = magnitudes, vectorised = magnitudes;
+
+		SpectrumKernels::magnitudesToDecibelsReference(reference.data(), numBins, scale, negativeInfinity);
+		SpectrumKernels::magnitudesToDecibels(vectorised.data(), numBins, scale, negativeInfinity);
+
+		float maxError = 0.0f;
+		for (int i = 0; i < numBins; ++i)
+			maxError = juce::jmax(maxError, std::abs(reference[(size_t)i] - vectorised[(size_t)i]));
+
+		if (maxError > SpectrumKernels::maxErrorDb)
+		{
+			std::cout << "SpectrumKernels::magnitudesToDecibels is off by " << maxError << " dB at " << numBins << " bins" << std::endl;
+			jassertfalse;
+		}
+
+		//both work in place, so every call starts from a fresh copy of the magnitudes
+		std::vector<float> work((size_t)numBins);
+		const int numCalls = 20000;
+
+		auto copyNs = measureNsPerCall(numCalls, [&] { std::copy(magnitudes.begin(), magnitudes.end(), work.begin()); });
+
+		auto referenceNs = measureNsPerCall(numCalls, [&]
+		{
+			std::copy(magnitudes.begin(), magnitudes.end(), work.begin());
+			SpectrumKernels::magnitudesToDecibelsReference(work.data(), numBins, scale, negativeInfinity);
+		});
+
+		auto vectorisedNs = measureNsPerCall(numCalls, [&]
+		{
+			std::copy(magnitudes.begin(), magnitudes.end(), work.begin());
+			SpectrumKernels::magnitudesToDecibels(work.data(), numBins, scale, negativeInfinity);
+		});
+
+		printResult({ "SpectrumKernels::magnitudesToDecibelsReference", numBins, juce::jmax(0.0, referenceNs - copyNs) });
+		printResult({ juce::String("SpectrumKernels::magnitudesToDecibels ") + SpectrumKernels::getKernelName(), numBins,
+					  juce::jmax(0.0, vectorisedNs - copyNs) });
+	}
+}
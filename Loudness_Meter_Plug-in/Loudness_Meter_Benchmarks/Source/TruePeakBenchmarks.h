@@ -0,0 +1,46 @@
+/*
+  ==============================================================================
+
+    SIMD true-peak kernel against the scalar reference.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "BenchmarkHarness.h"
+#include "../../Loudness_Meter/Source/TruePeakMeter.h"
+
+inline void runTruePeakBenchmarks()
+{
+	juce::Random random(3);
+
+	for (auto blockSize : { 32, 256, 2048 })
+	{
+		std::vector<float> samples((size_t)(TruePeakMeter::historySize + blockSize));
+		for (auto& s : samples)
+			s = random.nextFloat() * 2.0f - 1.0f;
+
+		auto* input = samples.data() + TruePeakMeter::historySize;
+
+		auto reference = TruePeakMeter::findPeakScalar(input, blockSize);
+		auto vectorised = TruePeakMeter::findPeak(input, blockSize);
+
+		//only the summation order differs between the two
+		if (std::abs(reference - vectorised) > 1.0e-5f)
+		{
+			std::cout << "TruePeakMeter::findPeak differs from the scalar reference for block size " << blockSize << std::endl;
+			jassertfalse;
+		}
+
+		float sink = 0.0f;
+		const int numCalls = juce::jmax(1000, 2000000 / blockSize);
+
+		printResult({ "TruePeakMeter::findPeakScalar", blockSize,
+					  measureNsPerCall(numCalls, [&] { sink += TruePeakMeter::findPeakScalar(input, blockSize); }) });
+		printResult({ juce::String("TruePeakMeter::findPeak ") + TruePeakMeter::getKernelName(), blockSize,
+					  measureNsPerCall(numCalls, [&] { sink += TruePeakMeter::findPeak(input, blockSize); }) });
+
+		juce::ignoreUnused(sink);
+	}
+}
@@ -0,0 +1,243 @@
+/*
+  ==============================================================================
+
+    Offline loudness / spectrum analysis of one audio file.
+
+  ==============================================================================
+*/
+
+#include "FileAnalyser.h"
+
+namespace
+{
+	//keeps the integrator fed and tracks the loudest momentary / short-term step
+	struct ReportListener : LoudnessMeter::Listener
+	{
+		void loudnessStepFinished(const LoudnessMeter::Step& step) override
+		{
+			integrator.loudnessStepFinished(step);
+
+			if (step.momentaryComplete)
+				maxMomentaryPower = juce::jmax(maxMomentaryPower, step.momentaryPower);
+
+			if (step.shortTermComplete)
+				maxShortTermPower = juce::jmax(maxShortTermPower, step.shortTermPower);
+		}
+
+		LoudnessIntegrator integrator;
+		double maxMomentaryPower = 0.0;
+		double maxShortTermPower = 0.0;
+	};
+
+	//ISO 266 third octaves from 20 Hz to 20 kHz
+	std::vector<float> getBandCentres()
+	{
+		std::vector<float> centres;
+
+		for (int band = -17; band <= 13; ++band)
+			centres.push_back(1000.0f * std::pow(2.0f, band / 3.0f));
+
+		return centres;
+	}
+
+	float toDecibels(double power)
+	{
+		return power > 0.0 ? juce::jmax(LoudnessMeter::minLoudness, (float)(10.0 * std::log10(power))) : LoudnessMeter::minLoudness;
+	}
+}
+
+juce::var FileReport::toVar() const
+{
+	auto* object = new juce::DynamicObject();
+
+	object->setProperty("file", file.getFullPathName());
+
+	if (!wasSuccessful())
+	{
+		object->setProperty("error", error);
+		return juce::var(object);
+	}
+
+	object->setProperty("sampleRate", sampleRate);
+	object->setProperty("numChannels", numChannels);
+	object->setProperty("durationSeconds", getDurationSeconds());
+	object->setProperty("integratedLUFS", integratedLoudness);
+	object->setProperty("loudnessRangeLU", loudnessRange);
+	object->setProperty("maxMomentaryLUFS", maxMomentaryLoudness);
+	object->setProperty("maxShortTermLUFS", maxShortTermLoudness);
+	object->setProperty("truePeakDBTP", truePeakDb);
+	object->setProperty("samplePeakDBFS", samplePeakDb);
+	object->setProperty("realtimeMultiple", getRealtimeMultiple());
+
+	juce::Array<juce::var> bands;
+	for (size_t i = 0; i < bandLevels.size(); ++i)
+	{
+		auto* band = new juce::DynamicObject();
+		band->setProperty("centreHz", bandCentres[i]);
+		band->setProperty("levelDB", bandLevels[i]);
+		bands.add(juce::var(band));
+	}
+	object->setProperty("averageSpectrum", bands);
+
+	return juce::var(object);
+}
+
+//==============================================================================
+FileAnalyser::FileAnalyser(juce::AudioFormatManager& formats, FFTOrder order) : formatManager(formats), fftOrder(order)
+{
+	fftDataGenerator.changeOrder(fftOrder);
+
+	const int fftSize = fftDataGenerator.getFFTSize();
+
+	monoFifo.allocate(blockSize + fftSize);
+	monoFifo.prepare();
+	monoBuffer.setSize(1, blockSize);
+	frameBuffer.setSize(1, fftSize);
+	fftData.resize((size_t)fftSize * 2, 0.0f);
+}
+
+std::unique_ptr<juce::AudioFormatReader> FileAnalyser::createReader(const juce::File& file)
+{
+	//wav and aiff can be mapped, everything else goes through a normal stream
+	std::unique_ptr<juce::MemoryMappedAudioFormatReader> mapped(formatManager.createMemoryMappedReader(file));
+
+	if (mapped != nullptr && mapped->mapEntireFile())
+		return std::move(mapped);
+
+	return std::unique_ptr<juce::AudioFormatReader>(formatManager.createReaderFor(file));
+}
+
+FileReport FileAnalyser::analyse(const juce::File& file)
+{
+	FileReport report;
+	report.file = file;
+
+	auto start = juce::Time::getHighResolutionTicks();
+
+	auto reader = createReader(file);
+	if (reader == nullptr)
+	{
+		report.error = "unsupported or unreadable file";
+		return report;
+	}
+
+	report.sampleRate = reader->sampleRate;
+	report.numChannels = (int)reader->numChannels;
+	report.lengthInSamples = reader->lengthInSamples;
+
+	if (report.numChannels < 1 || report.numChannels > LoudnessMeter::maxChannels)
+	{
+		report.error = "unsupported channel count " + juce::String(report.numChannels);
+		return report;
+	}
+
+	ReportListener listener;
+	LoudnessMeter loudnessMeter;
+	TruePeakMeter truePeakMeter;
+
+	loudnessMeter.setListener(&listener);
+	loudnessMeter.prepare(report.sampleRate, report.numChannels);
+	truePeakMeter.prepare(report.numChannels, blockSize);
+
+	auto layout = reader->getChannelLayout();
+	for (int ch = 0; ch < report.numChannels; ++ch)
+		loudnessMeter.setChannelWeight(ch, LoudnessMeter::getChannelWeight(layout.getTypeOfChannel(ch)));
+
+	const int fftSize = fftDataGenerator.getFFTSize();
+	const int hopSize = fftSize / 2;
+	std::vector<double> binPowers((size_t)fftSize / 2, 0.0);
+	int numFrames = 0;
+
+	juce::AudioBuffer<float> buffer(report.numChannels, blockSize);
+	float samplePeak = 0.0f;
+
+	frameBuffer.clear();
+	monoFifo.discardOldest(0);
+
+	for (juce::int64 position = 0; position < report.lengthInSamples; position += blockSize)
+	{
+		const int numSamples = (int)juce::jmin((juce::int64)blockSize, report.lengthInSamples - position);
+
+		buffer.setSize(report.numChannels, numSamples, false, false, true);
+		reader->read(&buffer, 0, numSamples, position, true, true);
+
+		loudnessMeter.process(buffer);
+		truePeakMeter.process(buffer);
+
+		monoBuffer.setSize(1, numSamples, false, false, true);
+		monoBuffer.copyFrom(0, 0, buffer, 0, 0, numSamples);
+
+		for (int ch = 0; ch < report.numChannels; ++ch)
+		{
+			samplePeak = juce::jmax(samplePeak, buffer.getMagnitude(ch, 0, numSamples));
+
+			if (ch > 0)
+				monoBuffer.addFrom(0, 0, buffer, ch, 0, numSamples);
+		}
+
+		monoBuffer.applyGain(1.0f / (float)report.numChannels);
+		monoFifo.update(monoBuffer);
+
+		//same framing as the editor's PathProducer, with a half frame hop
+		while (monoFifo.getNumSamplesAvailable() >= hopSize)
+		{
+			auto* frame = frameBuffer.getWritePointer(0);
+			std::copy(frame + hopSize, frame + fftSize, frame);
+			monoFifo.pullSamples(frame + fftSize - hopSize, hopSize);
+
+			fftDataGenerator.produceFFTDataForRendering(frameBuffer, LoudnessMeter::minLoudness);
+			addSpectrumFrame(binPowers);
+			++numFrames;
+		}
+	}
+
+	report.integratedLoudness = listener.integrator.getIntegratedLoudness();
+	report.loudnessRange = listener.integrator.getLoudnessRange();
+	report.maxMomentaryLoudness = LoudnessMeter::powerToLoudness(listener.maxMomentaryPower);
+	report.maxShortTermLoudness = LoudnessMeter::powerToLoudness(listener.maxShortTermPower);
+	report.truePeakDb = juce::Decibels::gainToDecibels(truePeakMeter.getMaxHold(), LoudnessMeter::minLoudness);
+	report.samplePeakDb = juce::Decibels::gainToDecibels(samplePeak, LoudnessMeter::minLoudness);
+
+	//bands narrower than a bin at the bottom end take the nearest bin
+	const double binWidth = report.sampleRate / (double)fftSize;
+	const int numBins = (int)binPowers.size();
+
+	report.bandCentres = getBandCentres();
+	for (auto centre : report.bandCentres)
+	{
+		const int first = juce::jlimit(1, numBins - 1, (int)std::ceil(centre * std::pow(2.0, -1.0 / 6.0) / binWidth));
+		const int last = juce::jlimit(first, numBins - 1, (int)std::ceil(centre * std::pow(2.0, 1.0 / 6.0) / binWidth) - 1);
+
+		double sum = 0.0;
+		for (int bin = first; bin <= last; ++bin)
+			sum += binPowers[(size_t)bin];
+
+		const double meanPower = numFrames > 0 ? sum / (double)((last - first + 1) * numFrames) : 0.0;
+		report.bandLevels.push_back(centre < report.sampleRate * 0.5 ? toDecibels(meanPower) : LoudnessMeter::minLoudness);
+	}
+
+	report.analysisSeconds = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - start);
+
+	return report;
+}
+
+void FileAnalyser::addSpectrumFrame(std::vector<double>& binPowers)
+{
+	while (fftDataGenerator.getFFTData(fftData))
+	{
+		for (size_t bin = 0; bin < binPowers.size(); ++bin)
+			binPowers[bin] += std::pow(10.0, fftData[bin] / 10.0);
+	}
+}
+
+//==============================================================================
+FileAnalysisJob::FileAnalysisJob(juce::AudioFormatManager& formats, FFTOrder order, const juce::File& fileToAnalyse)
+	: juce::ThreadPoolJob(fileToAnalyse.getFileName()), analyser(formats, order), file(fileToAnalyse)
+{
+}
+
+juce::ThreadPoolJob::JobStatus FileAnalysisJob::runJob()
+{
+	report = analyser.analyse(file);
+	return jobHasFinished;
+}
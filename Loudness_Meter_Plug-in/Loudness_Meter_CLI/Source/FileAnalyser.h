@@ -0,0 +1,87 @@
+/*
+  ==============================================================================
+
+    Offline loudness / spectrum analysis of one audio file.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "../../Loudness_Meter/Source/FFTDataGenerator.h"
+#include "../../Loudness_Meter/Source/LoudnessMeter.h"
+#include "../../Loudness_Meter/Source/TruePeakMeter.h"
+
+struct FileReport
+{
+	juce::File file;
+	juce::String error;
+
+	double sampleRate = 0.0;
+	int numChannels = 0;
+	juce::int64 lengthInSamples = 0;
+
+	float integratedLoudness = LoudnessMeter::minLoudness;
+	float loudnessRange = 0.0f;
+	float maxMomentaryLoudness = LoudnessMeter::minLoudness;
+	float maxShortTermLoudness = LoudnessMeter::minLoudness;
+	float truePeakDb = LoudnessMeter::minLoudness;
+	float samplePeakDb = LoudnessMeter::minLoudness;
+
+	//mean level of the mono downmix per third octave band, in dB
+	std::vector<float> bandCentres;
+	std::vector<float> bandLevels;
+
+	double analysisSeconds = 0.0;
+
+	bool wasSuccessful() const { return error.isEmpty(); }
+	double getDurationSeconds() const { return sampleRate > 0.0 ? (double)lengthInSamples / sampleRate : 0.0; }
+	/** How many times faster than realtime the file was analysed. */
+	double getRealtimeMultiple() const { return analysisSeconds > 0.0 ? getDurationSeconds() / analysisSeconds : 0.0; }
+
+	juce::var toVar() const;
+};
+
+/**
+ Streams one file through the same meters and FFT generator the plug-in uses.
+ Not thread safe, give every worker its own analyser.
+ */
+class FileAnalyser
+{
+public:
+	FileAnalyser(juce::AudioFormatManager& formats, FFTOrder order);
+
+	FileReport analyse(const juce::File& file);
+private:
+	static constexpr int blockSize = 4096;
+
+	std::unique_ptr<juce::AudioFormatReader> createReader(const juce::File& file);
+	void addSpectrumFrame(std::vector<double>& binPowers);
+
+	juce::AudioFormatManager& formatManager;
+	FFTOrder fftOrder;
+
+	FFTDataGeneratorRMS<std::vector<float>> fftDataGenerator;
+	SingleChannelSampleFifo<juce::AudioBuffer<float>> monoFifo{ 0 };
+	juce::AudioBuffer<float> monoBuffer, frameBuffer;
+	std::vector<float> fftData;
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(FileAnalyser)
+};
+
+//==============================================================================
+/** One file on the thread pool. */
+class FileAnalysisJob : public juce::ThreadPoolJob
+{
+public:
+	FileAnalysisJob(juce::AudioFormatManager& formats, FFTOrder order, const juce::File& fileToAnalyse);
+
+	JobStatus runJob() override;
+
+	const FileReport& getReport() const { return report; }
+private:
+	FileAnalyser analyser;
+	juce::File file;
+	FileReport report;
+};
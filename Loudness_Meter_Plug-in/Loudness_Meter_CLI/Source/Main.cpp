@@ -0,0 +1,120 @@
+/*
+  ==============================================================================
+
+    Headless batch analysis: loudness, peaks and average spectrum per file.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "FileAnalyser.h"
+
+namespace
+{
+	void printUsage()
+	{
+		std::cout << "Usage: Loudness_Meter_CLI [--threads N] [--order 11|12|13] [--report-dir DIR] file..." << std::endl
+			<< "Writes <file>.loudness.json into DIR (default: next to each file)." << std::endl;
+	}
+
+	juce::String formatDb(float db)
+	{
+		return db <= LoudnessMeter::minLoudness ? juce::String("-inf") : juce::String(db, 1);
+	}
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+	int numThreads = juce::SystemStats::getNumCpus();
+	FFTOrder order = FFTOrder::order8192;
+	juce::File reportDir;
+	juce::Array<juce::File> files;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const juce::String arg(argv[i]);
+
+		if (arg == "--threads" && i + 1 < argc)
+			numThreads = juce::jmax(1, juce::String(argv[++i]).getIntValue());
+		else if (arg == "--order" && i + 1 < argc)
+			order = static_cast<FFTOrder>(juce::jlimit((int)FFTOrder::order2048, (int)FFTOrder::order8192, juce::String(argv[++i]).getIntValue()));
+		else if (arg == "--report-dir" && i + 1 < argc)
+			reportDir = juce::File::getCurrentWorkingDirectory().getChildFile(argv[++i]);
+		else if (arg == "--help" || arg == "-h")
+		{
+			printUsage();
+			return 0;
+		}
+		else
+			files.add(juce::File::getCurrentWorkingDirectory().getChildFile(arg));
+	}
+
+	if (files.isEmpty())
+	{
+		printUsage();
+		return 1;
+	}
+
+	if (reportDir != juce::File() && !reportDir.createDirectory())
+	{
+		std::cout << "Cannot create " << reportDir.getFullPathName() << std::endl;
+		return 1;
+	}
+
+	juce::AudioFormatManager formatManager;
+	formatManager.registerBasicFormats();
+
+	juce::ThreadPool pool(numThreads);
+	juce::OwnedArray<FileAnalysisJob> jobs;
+
+	auto start = juce::Time::getHighResolutionTicks();
+
+	for (auto& file : files)
+		pool.addJob(jobs.add(new FileAnalysisJob(formatManager, order, file)), false);
+
+	int numFailed = 0;
+	double totalAudioSeconds = 0.0;
+
+	//reports come out in command line order, whatever order the jobs finish in
+	for (auto* job : jobs)
+	{
+		pool.waitForJobToFinish(job, -1);
+
+		const auto& report = job->getReport();
+
+		if (!report.wasSuccessful())
+		{
+			std::cout << report.file.getFullPathName() << ": " << report.error << std::endl;
+			++numFailed;
+			continue;
+		}
+
+		totalAudioSeconds += report.getDurationSeconds();
+
+		std::cout << report.file.getFileName() << ": "
+			<< "I " << formatDb(report.integratedLoudness) << " LUFS, "
+			<< "LRA " << juce::String(report.loudnessRange, 1) << " LU, "
+			<< "TP " << formatDb(report.truePeakDb) << " dBTP, "
+			<< "peak " << formatDb(report.samplePeakDb) << " dBFS, "
+			<< juce::String(report.getRealtimeMultiple(), 1) << "x realtime" << std::endl;
+
+		auto dir = reportDir != juce::File() ? reportDir : report.file.getParentDirectory();
+		auto reportFile = dir.getChildFile(report.file.getFileName() + ".loudness.json");
+
+		if (!reportFile.replaceWithText(juce::JSON::toString(report.toVar())))
+		{
+			std::cout << "Cannot write " << reportFile.getFullPathName() << std::endl;
+			++numFailed;
+		}
+	}
+
+	auto wallSeconds = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - start);
+
+	std::cout << files.size() - numFailed << " of " << files.size() << " files, "
+		<< juce::String(totalAudioSeconds, 1) << " s of audio in " << juce::String(wallSeconds, 2) << " s on "
+		<< numThreads << " threads, " << juce::String(wallSeconds > 0.0 ? totalAudioSeconds / wallSeconds : 0.0, 1)
+		<< "x realtime" << std::endl;
+
+	return numFailed == 0 ? 0 : 1;
+}